@@ -0,0 +1,91 @@
+#include "asyncio.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+block_writer_t::block_writer_t(const std::string &path) {
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  for (std::string &buf : bufs)
+    buf.reserve(OUTPUT_BLOCK + OUTPUT_BLOCK / 8);
+#ifdef HAVE_LIBURING
+  // fall back to plain writes when the kernel refuses a ring
+  ring_ok = fd >= 0 && io_uring_queue_init(OUTPUT_QUEUE_DEPTH, &ring, 0) == 0;
+#endif
+}
+
+// pwrite until everything is out, retrying short writes
+void block_writer_t::write_all(const char *data, size_t len, off_t at) {
+  while (len > 0) {
+    ssize_t n = pwrite(fd, data, len, at);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      std::cerr << "Write failed: " << n << '\n';
+      exit(EXIT_FAILURE);
+    }
+    data += n;
+    len -= n;
+    at += n;
+  }
+}
+
+#ifdef HAVE_LIBURING
+// retire finished writes, blocking for at least one when wait is set
+void block_writer_t::reap(bool wait) {
+  io_uring_cqe *cqe;
+  while ((wait ? io_uring_wait_cqe(&ring, &cqe) : io_uring_peek_cqe(&ring, &cqe)) == 0) {
+    int b = (int)(uintptr_t)io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+    // finish a short or failed write synchronously
+    size_t done = res > 0 ? res : 0;
+    if (done < bufs[b].size())
+      write_all(bufs[b].data() + done, bufs[b].size() - done, queued_at[b] + done);
+    bufs[b].clear();
+    busy[b] = false;
+    wait = false;
+  }
+}
+#endif
+
+void block_writer_t::commit() {
+  if (fd < 0 || bufs[cur].empty()) return;
+#ifdef HAVE_LIBURING
+  if (ring_ok) {
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, fd, bufs[cur].data(), bufs[cur].size(), offset);
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)cur);
+    io_uring_submit(&ring);
+    busy[cur] = true;
+    queued_at[cur] = offset;
+    offset += bufs[cur].size();
+    cur = (cur + 1) % OUTPUT_QUEUE_DEPTH;
+    reap(false);
+    while (busy[cur])
+      reap(true);
+    return;
+  }
+#endif
+  write_all(bufs[cur].data(), bufs[cur].size(), offset);
+  offset += bufs[cur].size();
+  bufs[cur].clear();
+}
+
+void block_writer_t::close() {
+  if (fd < 0) return;
+  commit();
+#ifdef HAVE_LIBURING
+  if (ring_ok) {
+    for (int b = 0; b < OUTPUT_QUEUE_DEPTH; b++)
+      while (busy[b])
+        reap(true);
+    io_uring_queue_exit(&ring);
+    ring_ok = false;
+  }
+#endif
+  ::close(fd);
+  fd = -1;
+}
@@ -0,0 +1,53 @@
+/**
+ * Block-buffered asynchronous file output
+ */
+
+#ifndef __ASYNCIO_H__
+#define __ASYNCIO_H__
+
+#include <string>
+#include <sys/types.h>
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define HAVE_LIBURING 1
+#endif
+
+#define OUTPUT_BLOCK (1 << 20)
+#define OUTPUT_QUEUE_DEPTH 4
+
+/* Writes a file as a sequence of blocks. The caller formats into block() and
+calls commit() whenever it holds OUTPUT_BLOCK bytes or more. With liburing a
+committed block is queued on an io_uring and written while the next one is
+being formatted, with up to OUTPUT_QUEUE_DEPTH blocks in flight. Without it
+each block is written with write(2) on the calling thread, which the
+pipelined shutdown already keeps off the main thread. close() (or the
+destructor) writes what is left and waits for everything to land. */
+class block_writer_t {
+public:
+  explicit block_writer_t(const std::string &path);
+  ~block_writer_t() { close(); }
+  block_writer_t(const block_writer_t &) = delete;
+  block_writer_t &operator=(const block_writer_t &) = delete;
+
+  bool ok() const { return fd >= 0; }
+  std::string &block() { return bufs[cur]; }
+  void commit();
+  void close();
+
+private:
+  int fd = -1;
+  off_t offset = 0;
+  int cur = 0;
+  std::string bufs[OUTPUT_QUEUE_DEPTH];
+  void write_all(const char *data, size_t len, off_t at);
+#ifdef HAVE_LIBURING
+  io_uring ring;
+  bool ring_ok = false;
+  bool busy[OUTPUT_QUEUE_DEPTH] = {};
+  off_t queued_at[OUTPUT_QUEUE_DEPTH] = {};
+  void reap(bool wait);
+#endif
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+void snapshot_out_t::header(const snapshot_header_t &h) {
+  buf += SNAPSHOT_MAGIC;
+  u8(SNAPSHOT_VERSION);
+  u8(h.mode);
+  str(h.cost);
+  varint(h.dim_x);
+  varint(h.dim_y);
+  varint(h.num_wires);
+  varint(h.endpoints);
+  varint(h.num_threads);
+  varint(h.batch_size);
+  varint(h.num_replicas);
+  varint(h.iters);
+  varint(h.next_iter);
+  varint(h.seed);
+  f64(h.prob);
+  f64(h.max_temp);
+  varint(h.budget_routes);
+  f64(h.budget_per_cell);
+}
+
+void snapshot_out_t::wires(const std::vector<Wire> &wires) {
+  varint(wires.size());
+  Point prev = { 0, 0 };
+  for (const Wire &w : wires) {
+    u8(w.num_pts);
+    for (int i = 0; i < w.num_pts; i++) {
+      svarint(w.pts[i].x - prev.x);
+      svarint(w.pts[i].y - prev.y);
+      prev = w.pts[i];
+    }
+  }
+}
+
+void snapshot_out_t::rng(const std::mt19937 &gen) {
+  std::ostringstream out;
+  out << gen;
+  str(out.str());
+}
+
+snapshot_header_t snapshot_in_t::header() {
+  snapshot_header_t h;
+  const std::string magic = SNAPSHOT_MAGIC;
+  for (char c : magic)
+    if (char(u8()) != c)
+      failed = true;
+  if (u8() != SNAPSHOT_VERSION)
+    failed = true;
+  h.mode = u8();
+  h.cost = str();
+  h.dim_x = varint();
+  h.dim_y = varint();
+  h.num_wires = varint();
+  h.endpoints = varint();
+  h.num_threads = varint();
+  h.batch_size = varint();
+  h.num_replicas = varint();
+  h.iters = varint();
+  h.next_iter = varint();
+  h.seed = varint();
+  h.prob = f64();
+  h.max_temp = f64();
+  h.budget_routes = varint();
+  h.budget_per_cell = f64();
+  return h;
+}
+
+void snapshot_in_t::wires(std::vector<Wire> &wires) {
+  if (varint() != wires.size()) {
+    failed = true;
+    return;
+  }
+  Point prev = { 0, 0 };
+  for (Wire &w : wires) {
+    w = Wire{};
+    w.num_pts = u8();
+    if (w.num_pts < 2 || w.num_pts > MAX_PTS_PER_WIRE) {
+      failed = true;
+      return;
+    }
+    for (int i = 0; i < w.num_pts; i++) {
+      w.pts[i].x = prev.x + svarint();
+      w.pts[i].y = prev.y + svarint();
+      prev = w.pts[i];
+    }
+  }
+}
+
+void snapshot_in_t::rng(std::mt19937 &gen) {
+  std::istringstream in(str());
+  if (!(in >> gen))
+    failed = true;
+}
+
+std::string read_snapshot(const std::string &path) {
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin)
+    return "";
+  std::ostringstream data;
+  data << fin.rdbuf();
+  return data.str();
+}
+
+uint64_t endpoint_hash(const std::vector<Wire> &wires) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  auto mix = [&](int v) {
+    for (int b = 0; b < 32; b += 8) {
+      h ^= uint8_t(uint32_t(v) >> b);
+      h *= 0x100000001b3ull;
+    }
+  };
+  for (const Wire &w : wires) {
+    const Point start = w.pts[0], end = w.pts[w.num_pts - 1];
+    mix(start.x);
+    mix(start.y);
+    mix(end.x);
+    mix(end.y);
+  }
+  return h;
+}
+
+void checkpointer_t::write(std::string buf) {
+  const double t0 = omp_get_wtime();
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    out.write(buf.data(), buf.size());
+    if (!out) {
+      std::cerr << "Unable to write snapshot: " << tmp << '\n';
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    std::cerr << "Unable to write snapshot: " << path << '\n';
+  write_time += omp_get_wtime() - t0;
+}
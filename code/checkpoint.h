@@ -0,0 +1,246 @@
+/**
+ * Routing state snapshots for --checkpoint and --resume
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <omp.h>
+
+#include "wireroute.h"
+
+#define SNAPSHOT_MAGIC "WRSNAP"
+#define SNAPSHOT_VERSION 2
+
+/* What a snapshot was taken from. The settings that decide which numbers a
+solver draws are all here, so a resumed run takes them from the snapshot
+instead of the command line; next_iter is the first iteration still to run.
+endpoints is the endpoint_hash of the board, so a resume refuses a board the
+snapshot was not taken from even when its size and wire count agree. */
+struct snapshot_header_t {
+  char mode = '\0';
+  std::string cost;
+  int dim_x = 0, dim_y = 0, num_wires = 0;
+  uint64_t endpoints = 0;
+  int num_threads = 0, batch_size = 0, num_replicas = 0;
+  int iters = 0, next_iter = 0;
+  unsigned seed = 0;
+  double prob = 0, max_temp = 0;
+  long long budget_routes = 0;
+  double budget_per_cell = 0;
+};
+
+/* Appends the snapshot encoding to a byte buffer. Integers are LEB128
+varints, signed ones zigzagged first. Wires are their keypoints, each point
+a delta from the one before it. A grid is the row-major list of its nonzero
+cells, each as the gap of zero cells before it and its count, so a mostly
+empty board stays small whatever its size. A generator is its standard text
+form, which round-trips the full engine state. */
+class snapshot_out_t {
+public:
+  std::string buf;
+
+  void u8(uint8_t v) { buf.push_back(char(v)); }
+  void varint(uint64_t v) {
+    for (; v >= 0x80; v >>= 7)
+      u8(uint8_t(v) | 0x80);
+    u8(uint8_t(v));
+  }
+  void svarint(int64_t v) { varint((uint64_t(v) << 1) ^ uint64_t(v >> 63)); }
+  void f64(double v) { buf.append(reinterpret_cast<const char *>(&v), sizeof v); }
+  void str(const std::string &s) {
+    varint(s.size());
+    buf += s;
+  }
+
+  void header(const snapshot_header_t &h);
+  void wires(const std::vector<Wire> &wires);
+  void rng(const std::mt19937 &gen);
+
+  template <typename Grid> void grid(const Grid &g) {
+    snapshot_out_t cells;
+    long long count = 0, pos = 0, last = 0;
+    for (int y = 0; y < grid_dim_y(g); y++) {
+      for_each_row_run(g, y, [&](const int *counts, int n, bool all_zero) {
+        for (int x = 0; x < n && !all_zero; x++) {
+          if (counts[x] == 0) continue;
+          cells.varint(pos + x - last);
+          cells.svarint(counts[x]);
+          last = pos + x + 1;
+          count++;
+        }
+        pos += n;
+      });
+    }
+    varint(count);
+    buf += cells.buf;
+  }
+};
+
+/* Reads back what snapshot_out_t wrote. A truncated or corrupt snapshot
+marks the reader failed and reads as zeros from then on, so callers check
+ok() once at the end instead of after every field. */
+class snapshot_in_t {
+public:
+  explicit snapshot_in_t(std::string data) : data(std::move(data)) {}
+
+  bool ok() const { return !failed; }
+  uint8_t u8() {
+    if (pos >= data.size()) {
+      failed = true;
+      return 0;
+    }
+    return uint8_t(data[pos++]);
+  }
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t b = u8();
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    failed = true;
+    return 0;
+  }
+  int64_t svarint() {
+    uint64_t v = varint();
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+  }
+  double f64() {
+    double v = 0;
+    if (pos + sizeof v > data.size())
+      failed = true;
+    else
+      data.copy(reinterpret_cast<char *>(&v), sizeof v, pos);
+    pos += sizeof v;
+    return v;
+  }
+  std::string str() {
+    size_t n = varint();
+    if (n > data.size() - std::min(pos, data.size())) {
+      failed = true;
+      return "";
+    }
+    pos += n;
+    return data.substr(pos - n, n);
+  }
+
+  snapshot_header_t header();
+  void wires(std::vector<Wire> &wires);
+  void rng(std::mt19937 &gen);
+
+  template <typename Grid> void grid(Grid &g) {
+    clear_grid(g);
+    const long long dim_x = grid_dim_x(g), cells = dim_x * grid_dim_y(g);
+    long long pos = 0;
+    for (long long n = varint(); n > 0 && ok(); n--) {
+      pos += varint();
+      if (pos >= cells) {
+        failed = true;
+        return;
+      }
+      g[pos / dim_x][pos % dim_x] = svarint();
+      pos++;
+    }
+  }
+
+private:
+  std::string data;
+  size_t pos = 0;
+  bool failed = false;
+};
+
+// the whole snapshot file, empty when it cannot be read
+std::string read_snapshot(const std::string &path);
+
+// FNV-1a hash of every wire's two endpoints in order; rerouting keeps it
+uint64_t endpoint_hash(const std::vector<Wire> &wires);
+
+/* Takes the snapshots of one solve. A solver calls save() at an iteration
+boundary while its state holds still: the encode runs on the calling thread
+and is all the solver waits for, then a background thread writes the buffer
+to path.tmp and renames it over path, so a run killed mid-write still leaves
+the previous snapshot whole. A save that finds the previous write still in
+flight waits for it first. */
+class checkpointer_t {
+public:
+  checkpointer_t(const std::string &path, int every, const snapshot_header_t &header)
+      : path(path), every(every), header(header) {}
+  ~checkpointer_t() { finish(); }
+  checkpointer_t(const checkpointer_t &) = delete;
+  checkpointer_t &operator=(const checkpointer_t &) = delete;
+
+  // a snapshot is due once every `every` completed iterations
+  bool due(int done) const { return every > 0 && done % every == 0; }
+
+  // fill(out) encodes the solver's state after next_iter iterations
+  template <typename F> void save(int next_iter, F fill) {
+    const double t0 = omp_get_wtime();
+    snapshot_out_t out;
+    header.next_iter = next_iter;
+    out.header(header);
+    fill(out);
+    const double t1 = omp_get_wtime();
+    wait();
+    const double t2 = omp_get_wtime();
+    encode_time += t1 - t0;
+    wait_time += t2 - t1;
+    bytes += out.buf.size();
+    count++;
+    writer = std::thread(&checkpointer_t::write, this, std::move(out.buf));
+  }
+
+  // waits for the last snapshot to land
+  void finish() {
+    const double t0 = omp_get_wtime();
+    wait();
+    wait_time += omp_get_wtime() - t0;
+  }
+
+  int count = 0;
+  long long bytes = 0;
+  double encode_time = 0;   // solver time spent encoding
+  double wait_time = 0;     // solver time spent waiting for earlier writes
+  double write_time = 0;    // background time spent writing
+
+private:
+  std::string path;
+  int every;
+  snapshot_header_t header;
+  std::thread writer;
+
+  void wait() {
+    if (writer.joinable())
+      writer.join();
+  }
+  void write(std::string buf);
+};
+
+// generator for thread tid in iteration t, so a solve resumed at any
+// iteration boundary draws the same numbers as one that never stopped
+inline std::mt19937 iteration_gen(unsigned seed, int t, int tid) {
+  std::seed_seq seq{ seed, unsigned(t), unsigned(tid) };
+  return std::mt19937(seq);
+}
+
+/* What a solver gets for checkpointing: where to save (nothing when out is
+null) and, when resuming, the snapshot positioned just past its header with
+the iteration to start from. */
+struct snapshot_ctl_t {
+  checkpointer_t *out = nullptr;
+  snapshot_in_t *in = nullptr;
+  int start_iter = 0;
+
+  // whether a snapshot is due after done of iters iterations; the state
+  // after the last one is the solver's output
+  bool due(int done, int iters) const { return out && done < iters && out->due(done); }
+};
+
+#endif
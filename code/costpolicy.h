@@ -0,0 +1,114 @@
+/**
+ * Routing cost policies
+ */
+
+#ifndef __COSTPOLICY_H__
+#define __COSTPOLICY_H__
+
+#include <algorithm>
+#include <string>
+
+#include "wireroute.h"
+
+#define OVERFLOW_CAPACITY 2
+#define OVERFLOW_PENALTY 16
+#define LINQUAD_LINEAR 2
+#define TIEBREAK_SHIFT 20
+
+/* A cost policy is a stateless struct that the solvers take as a template
+parameter, so every objective gets its own fully specialized solver and the
+scan loops never branch on which one is in use. A policy provides:
+
+  value_t      type the candidate scan accumulates route costs in
+  unit         value_t of one unit of the objective, so thresholds given
+               per cell (-M) mean the same under every policy
+  cell(occ)    what a route pays for a cell that already carries occ other
+               wires; always total(occ + 1) scaled by unit, plus any
+               tie-break term
+  route(n)     a per-route term added once to the sum of cell() over n
+  total(count) what a cell carrying count wires adds to the board cost that
+               print_stats reports and parallel tempering minimizes
+
+cost_for_path, marginal_cost, the maze weights and print_stats are all
+written in terms of these. -c, its usage message and route_file all go
+through cost_policies below, so a new objective is one more struct here plus
+its entry in that list. */
+
+// the classic objective: sum of squared occupancies
+struct quadratic_cost {
+  typedef int value_t;
+  static constexpr const char *name = "quadratic";
+  static constexpr value_t unit = 1;
+  static value_t cell(int occ) { return (occ + 1) * (occ + 1); }
+  static value_t route(const Wire &) { return 0; }
+  static long long total(int count) { return (long long)count * count; }
+};
+
+// every wire costs 1 per cell, and wires beyond Capacity sharing a cell pay
+// Penalty times the square of the overflow
+template <int Capacity, int Penalty>
+struct overflow_cost {
+  typedef int value_t;
+  static constexpr const char *name = "overflow";
+  static constexpr value_t unit = 1;
+  static value_t cell(int occ) { return total(occ + 1); }
+  static value_t route(const Wire &) { return 0; }
+  static long long total(int count) {
+    int over = std::max(0, count - Capacity);
+    return count + (long long)Penalty * over * over;
+  }
+};
+
+// wire length weighted by Linear on top of the squared occupancies
+template <int Linear>
+struct linquad_cost {
+  typedef int value_t;
+  static constexpr const char *name = "linquad";
+  static constexpr value_t unit = 1;
+  static value_t cell(int occ) { return total(occ + 1); }
+  static value_t route(const Wire &) { return 0; }
+  static long long total(int count) { return (long long)count * (count + Linear); }
+};
+
+/* Squared occupancies as the objective; among routes of equal cost the one
+with fewer cells wins, then the one with fewer bends. The objective sits in
+the bits above Shift so the tie-break can never outweigh it, which needs
+64-bit route costs. All <=3-bend routes of a wire are equally long, so in
+the candidate scan it is the bend count that breaks the ties. */
+template <int Shift>
+struct tiebreak_cost {
+  typedef long long value_t;
+  static constexpr const char *name = "tiebreak";
+  static constexpr value_t unit = value_t(1) << Shift;
+  static value_t cell(int occ) { return (value_t(occ + 1) * (occ + 1) << Shift) + 1; }
+  static value_t route(const Wire &n) { return n.num_pts - 2; }
+  static long long total(int count) { return (long long)count * count; }
+};
+
+typedef overflow_cost<OVERFLOW_CAPACITY, OVERFLOW_PENALTY> default_overflow_cost;
+typedef linquad_cost<LINQUAD_LINEAR> default_linquad_cost;
+typedef tiebreak_cost<TIEBREAK_SHIFT> default_tiebreak_cost;
+
+// the policies -c selects between by name
+template <typename... Policies>
+struct cost_list {
+  static bool has(const std::string &name) { return ((name == Policies::name) || ...); }
+
+  // the names joined by '|', for usage messages
+  static std::string names() {
+    std::string s;
+    ((s += (s.empty() ? "" : "|") + std::string(Policies::name)), ...);
+    return s;
+  }
+
+  // calls f(Policy{}) for the policy called name; false when there is none
+  template <typename F>
+  static bool dispatch(const std::string &name, F f) {
+    return ((name == Policies::name && (f(Policies{}), true)) || ...);
+  }
+};
+
+typedef cost_list<quadratic_cost, default_overflow_cost, default_linquad_cost,
+                  default_tiebreak_cost> cost_policies;
+
+#endif
@@ -0,0 +1,181 @@
+#include "heatmap.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+#include <omp.h>
+
+// heat palette stops: black -> blue -> red -> yellow -> white
+static const float PALETTE[][3] = {
+  { 0, 0, 0 }, { 0, 0, 255 }, { 255, 0, 0 }, { 255, 255, 0 }, { 255, 255, 255 },
+};
+#define PALETTE_STOPS 5
+static const uint8_t OVERLAY_COLOR[3] = { 0, 255, 255 };
+
+static void heat_color(float v, uint8_t *px) {
+  float pos = std::clamp(v, 0.f, 1.f) * (PALETTE_STOPS - 1);
+  int lo = std::min(int(pos), PALETTE_STOPS - 2);
+  float frac = pos - lo;
+  for (int c = 0; c < 3; c++)
+    px[c] = uint8_t(PALETTE[lo][c] + frac * (PALETTE[lo + 1][c] - PALETTE[lo][c]));
+}
+
+static void put_be32(std::string &buf, uint32_t v) {
+  buf.push_back(char(v >> 24));
+  buf.push_back(char(v >> 16));
+  buf.push_back(char(v >> 8));
+  buf.push_back(char(v));
+}
+
+static uint32_t crc32(const std::string &buf, size_t from) {
+  // built once on first use; a function-local static initializes thread-safely
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t;
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  uint32_t c = 0xffffffffu;
+  for (size_t i = from; i < buf.size(); i++)
+    c = table[(c ^ uint8_t(buf[i])) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffu;
+}
+
+static void put_chunk(std::ofstream &out, const char *type, const std::string &data) {
+  std::string chunk;
+  put_be32(chunk, data.size());
+  chunk.append(type, 4);
+  chunk.append(data);
+  put_be32(chunk, crc32(chunk, 4));
+  out.write(chunk.data(), chunk.size());
+}
+
+/* PNG without a compressor: the image goes into a zlib stream made only of
+stored deflate blocks, which every decoder accepts */
+static void write_png(std::ofstream &out, int w, int h,
+                      const std::vector<uint8_t> &pixels) {
+  static const char SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+  out.write(SIGNATURE, 8);
+
+  std::string ihdr;
+  put_be32(ihdr, w);
+  put_be32(ihdr, h);
+  ihdr += std::string("\x08\x02\x00\x00\x00", 5); // 8-bit RGB, no interlace
+  put_chunk(out, "IHDR", ihdr);
+
+  // every scanline is prefixed with filter type 0
+  std::string raw;
+  raw.reserve(size_t(h) * (3 * w + 1));
+  for (int y = 0; y < h; y++) {
+    raw.push_back(0);
+    raw.append(reinterpret_cast<const char *>(&pixels[size_t(y) * w * 3]), w * 3);
+  }
+
+  std::string idat = "\x78\x01";
+  uint32_t a = 1, b = 0;
+  for (unsigned char c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  size_t pos = 0;
+  do {
+    size_t len = std::min<size_t>(65535, raw.size() - pos);
+    idat.push_back(pos + len == raw.size() ? 1 : 0);
+    idat.push_back(char(len));
+    idat.push_back(char(len >> 8));
+    idat.push_back(char(~len));
+    idat.push_back(char(~len >> 8));
+    idat.append(raw, pos, len);
+    pos += len;
+  } while (pos < raw.size());
+  put_be32(idat, (b << 16) | a);
+  put_chunk(out, "IDAT", idat);
+  put_chunk(out, "IEND", "");
+}
+
+static void write_ppm(std::ofstream &out, int w, int h,
+                      const std::vector<uint8_t> &pixels) {
+  out << "P6\n" << w << ' ' << h << "\n255\n";
+  out.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+}
+
+template <typename Grid>
+void render_heatmap(const Grid &occupancy, const heatmap_opts &opts,
+                    const std::string &path, std::ostream &log) {
+  const int dim_y = grid_dim_y(occupancy);
+  const int dim_x = grid_dim_x(occupancy);
+  const int factor = std::max(1, (std::max(dim_x, dim_y) + opts.max_size - 1) / opts.max_size);
+  const int out_w = (dim_x + factor - 1) / factor;
+  const int out_h = (dim_y + factor - 1) / factor;
+  const int team = opts.num_threads > 0 ? opts.num_threads : omp_get_max_threads();
+
+  // pool each factor x factor block, one band of output rows at a time
+  std::vector<float> pooled(size_t(out_w) * out_h);
+  float vmax = 0;
+  #pragma omp parallel for num_threads(team) schedule(dynamic, 4) reduction(max: vmax)
+  for (int oy = 0; oy < out_h; oy++) {
+    float *acc = &pooled[size_t(oy) * out_w];
+    const int y_end = std::min(dim_y, (oy + 1) * factor);
+    for (int y = oy * factor; y < y_end; y++) {
+      const auto &row = occupancy[y];
+      for (int ox = 0; ox < out_w; ox++) {
+        const int x_end = std::min(dim_x, (ox + 1) * factor);
+        float cell = acc[ox];
+        for (int x = ox * factor; x < x_end; x++)
+          cell = opts.mean_pool ? cell + row[x] : std::max(cell, float(row[x]));
+        acc[ox] = cell;
+      }
+    }
+    for (int ox = 0; ox < out_w; ox++) {
+      if (opts.mean_pool) {
+        int w = std::min(dim_x, (ox + 1) * factor) - ox * factor;
+        acc[ox] /= float(w) * (y_end - oy * factor);
+      }
+      vmax = std::max(vmax, acc[ox]);
+    }
+  }
+
+  std::vector<uint8_t> pixels(size_t(out_w) * out_h * 3);
+  #pragma omp parallel for num_threads(team) schedule(static)
+  for (size_t i = 0; i < pooled.size(); i++)
+    heat_color(vmax > 0 ? pooled[i] / vmax : 0, &pixels[i * 3]);
+
+  if (opts.overlay) {
+    for (const Wire &wire : *opts.overlay) {
+      for (int s = 0; s + 1 < wire.num_pts; s++) {
+        int x = wire.pts[s].x / factor, y = wire.pts[s].y / factor;
+        int x_n = wire.pts[s + 1].x / factor, y_n = wire.pts[s + 1].y / factor;
+        while (true) {
+          std::copy(OVERLAY_COLOR, OVERLAY_COLOR + 3, &pixels[(size_t(y) * out_w + x) * 3]);
+          if (x == x_n && y == y_n) break;
+          x += sgn(x_n - x);
+          y += sgn(y_n - y);
+        }
+      }
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cerr << "Unable to open file: " << path << '\n';
+    exit(EXIT_FAILURE);
+  }
+  if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0)
+    write_png(out, out_w, out_h, pixels);
+  else
+    write_ppm(out, out_w, out_h, pixels);
+  log << "Heatmap: " << out_w << 'x' << out_h << " (" << factor
+      << "x pooling, peak " << vmax << ") written to " << path << '\n';
+}
+
+template void render_heatmap<matrix_t>(const matrix_t &, const heatmap_opts &,
+                                       const std::string &, std::ostream &);
+template void render_heatmap<tiled_grid_t>(const tiled_grid_t &, const heatmap_opts &,
+                                           const std::string &, std::ostream &);
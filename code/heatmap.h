@@ -0,0 +1,38 @@
+/**
+ * Congestion heatmap rendering for occupancy grids
+ */
+
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wireroute.h"
+
+#define HEATMAP_DEFAULT_SIZE 1024
+
+/* Options for render_heatmap.
+
+The grid is pooled down by a whole factor so that neither side of the image
+exceeds max_size pixels; every pixel summarizes a factor x factor block of
+cells by either its max or its mean occupancy. Colors are scaled against the
+largest pooled value. Pooling runs on num_threads threads, the OpenMP default
+when 0. If an overlay is given the wire keypoints are drawn on top of the
+heatmap. The format is picked from the output file extension: ".png" writes
+an uncompressed PNG, anything else a binary PPM.
+*/
+struct heatmap_opts {
+  int max_size = HEATMAP_DEFAULT_SIZE;
+  bool mean_pool = false;
+  int num_threads = 0;
+  const std::vector<Wire> *overlay = nullptr;
+};
+
+// instantiated for both matrix_t and tiled_grid_t
+template <typename Grid>
+void render_heatmap(const Grid &occupancy, const heatmap_opts &opts,
+                    const std::string &path, std::ostream &log = std::cout);
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * Standalone congestion heatmap renderer for wireroute outputs
+ */
+
+#include "heatmap.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+#include <unistd.h>
+
+static const char *parse_int(const char *p, const char *end, int &v) {
+  while (p < end && (*p < '0' || *p > '9'))
+    p++;
+  v = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    v = v * 10 + (*p++ - '0');
+  return p;
+}
+
+static std::string slurp(const std::string &path) {
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin) {
+    std::cerr << "Unable to open file: " << path << ".\n";
+    exit(EXIT_FAILURE);
+  }
+  std::ostringstream ss;
+  ss << fin.rdbuf();
+  return ss.str();
+}
+
+/* Reads occ_output.txt: the header line holds dim_x and dim_y, then one line
+per grid row. Line starts are found serially, rows are parsed in parallel. */
+static std::vector<std::vector<int>> read_occupancy(const std::string &path) {
+  const std::string buf = slurp(path);
+  const char *begin = buf.data(), *end = begin + buf.size();
+
+  int dim_x, dim_y;
+  const char *p = parse_int(begin, end, dim_x);
+  p = parse_int(p, end, dim_y);
+  p = static_cast<const char *>(memchr(p, '\n', end - p));
+
+  std::vector<const char *> rows(dim_y + 1, end);
+  for (int y = 0; y < dim_y && p; y++) {
+    rows[y] = ++p;
+    p = static_cast<const char *>(memchr(p, '\n', end - p));
+  }
+  if (dim_y <= 0 || rows[dim_y - 1] == end) {
+    std::cerr << "Truncated occupancy file: " << path << '\n';
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector occupancy(dim_y, std::vector<int>(dim_x));
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (int y = 0; y < dim_y; y++) {
+    const char *q = rows[y];
+    for (int x = 0; x < dim_x; x++)
+      q = parse_int(q, rows[y + 1], occupancy[y][x]);
+  }
+  return occupancy;
+}
+
+// reads the keypoint lines of wire_output.txt back into Wires
+static std::vector<Wire> read_wires(const std::string &path) {
+  std::ifstream fin(path);
+  if (!fin) {
+    std::cerr << "Unable to open file: " << path << ".\n";
+    exit(EXIT_FAILURE);
+  }
+  int dim_x, dim_y, num_wires;
+  fin >> dim_x >> dim_y >> num_wires;
+  std::string line;
+  std::getline(fin, line);
+
+  std::vector<Wire> wires;
+  wires.reserve(num_wires);
+  while (std::getline(fin, line)) {
+    std::istringstream ls(line);
+    Wire w{};
+    while (w.num_pts < MAX_PTS_PER_WIRE && ls >> w.pts[w.num_pts].x >> w.pts[w.num_pts].y)
+      w.num_pts++;
+    if (w.num_pts >= 2)
+      wires.push_back(w);
+  }
+  return wires;
+}
+
+int main(int argc, char *argv[]) {
+  std::string occ_filename = "outputs/occ_output.txt";
+  std::string wire_filename;
+  std::string output_filename = "outputs/occ_heatmap.png";
+  heatmap_opts opts;
+  int num_threads = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:w:O:s:n:M")) != -1) {
+    switch (opt) {
+    case 'o':
+      occ_filename = optarg;
+      break;
+    case 'w':
+      wire_filename = optarg;
+      break;
+    case 'O':
+      output_filename = optarg;
+      break;
+    case 's':
+      opts.max_size = atoi(optarg);
+      break;
+    case 'n':
+      num_threads = atoi(optarg);
+      break;
+    case 'M':
+      opts.mean_pool = true;
+      break;
+    default:
+      std::cerr << "Usage: " << argv[0]
+                << " [-o occ_file] [-w wire_file] [-O output_image] "
+                   "[-s max_size] [-n num_threads] [-M]\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (opts.max_size <= 0 || num_threads < 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-o occ_file] [-w wire_file] [-O output_image] "
+                 "[-s max_size] [-n num_threads] [-M]\n";
+    exit(EXIT_FAILURE);
+  }
+  if (num_threads > 0)
+    omp_set_num_threads(num_threads);
+  opts.num_threads = num_threads;
+
+  std::vector<std::vector<int>> occupancy = read_occupancy(occ_filename);
+  std::vector<Wire> wires;
+  if (!wire_filename.empty()) {
+    wires = read_wires(wire_filename);
+    opts.overlay = &wires;
+  }
+  render_heatmap(occupancy, opts, output_filename);
+}
@@ -0,0 +1,294 @@
+/**
+ * Microbenchmarks for the routing kernels
+ */
+
+// pull in the kernels themselves, templates and all, without wireroute's main
+#define WIREROUTE_NO_MAIN
+#include "wireroute.cpp"
+
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+// every operator new in the process goes through here so that benchmarks
+// can report allocations per op
+static std::atomic<long long> num_allocs{0};
+
+void *operator new(size_t size) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+// kept out of line, gcc mistakes an inlined free for a mismatched delete
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+struct bench_opts_t {
+  int dim = 1024;           // board is dim x dim
+  int span = 64;            // largest |dx| and |dy| of a wire
+  double congestion = 2.0;  // mean occupancy of the background layout
+  int num_wires = 1024;     // wires each kernel is run over
+  int warmup = 1;
+  int reps = 5;
+  int num_threads = 1;      // for get_all_wires
+  unsigned seed = 1;
+  bool sparse = false;
+  std::string filter;       // only run benchmarks whose name contains this
+};
+
+// what one repetition of a benchmark did
+struct bench_work_t {
+  long long ops;
+  long long cells;
+};
+
+struct bench_t {
+  const char *name;
+  std::function<bench_work_t()> run;
+};
+
+/* Runs b warmup times untimed, then reps times, and prints the median
+repetition's ns/op and cells/sec next to the allocations per op averaged
+over all timed repetitions. */
+void run_bench(const bench_t &b, const bench_opts_t &opts) {
+  for (int i = 0; i < opts.warmup; i++)
+    b.run();
+
+  std::vector<double> ns_per_op, cells_per_sec;
+  long long allocs = 0, ops = 0;
+  for (int i = 0; i < opts.reps; i++) {
+    const long long allocs_before = num_allocs.load();
+    const double t0 = omp_get_wtime();
+    const bench_work_t work = b.run();
+    const double elapsed = omp_get_wtime() - t0;
+    allocs += num_allocs.load() - allocs_before;
+    ops += work.ops;
+    ns_per_op.push_back(elapsed * 1e9 / std::max(1LL, work.ops));
+    cells_per_sec.push_back(work.cells / std::max(elapsed, 1e-12));
+  }
+  std::sort(ns_per_op.begin(), ns_per_op.end());
+  std::sort(cells_per_sec.begin(), cells_per_sec.end());
+
+  std::cout << std::left << std::setw(20) << b.name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(14) << ns_per_op[opts.reps / 2]
+            << std::setprecision(3) << std::setw(14) << cells_per_sec[opts.reps / 2] / 1e6
+            << std::setprecision(2) << std::setw(12) << double(allocs) / std::max(1LL, ops)
+            << '\n';
+}
+
+// a wire from a uniform start to a different point at most span away on
+// each axis
+Wire random_wire(std::mt19937 &gen, int dim, int span) {
+  std::uniform_int_distribution<int> coord(0, dim - 1), off(-span, span);
+  Wire w{};
+  do {
+    w.pts[0] = { coord(gen), coord(gen) };
+    w.pts[2] = { std::clamp(w.pts[0].x + off(gen), 0, dim - 1),
+                 std::clamp(w.pts[0].y + off(gen), 0, dim - 1) };
+  } while (w.pts[0] == w.pts[2]);
+  return w;
+}
+
+// the wire lines of an input file, in the format read_wires parses
+std::string wire_lines(const wire_set_t &wires) {
+  std::ostringstream out;
+  for (const Wire &w : wires)
+    out << w.pts[0].x << ' ' << w.pts[0].y << ' ' << w.pts[2].x << ' ' << w.pts[2].y << '\n';
+  return out.str();
+}
+
+int wire_length(const Wire &w) {
+  const Point start = w.pts[0], end = w.pts[w.num_pts - 1];
+  return std::abs(end.x - start.x) + std::abs(end.y - start.y) + 1;
+}
+
+/* Builds the synthetic board: background wires are laid down until the mean
+occupancy reaches opts.congestion, then the num_wires benchmark wires go on
+top along their initial routes. Every kernel then runs over those wires. */
+template <typename Grid>
+void run_suite(const bench_opts_t &opts) {
+  std::mt19937 gen(opts.seed);
+  Grid occupancy = make_grid<Grid>(opts.dim, opts.dim);
+
+  wire_set_t background;
+  const double target = opts.congestion * opts.dim * opts.dim;
+  for (double laid = 0; laid < target;) {
+    Wire w = random_wire(gen, opts.dim, opts.span);
+    background.push_back(w);
+    laid += std::abs(w.pts[2].x - w.pts[0].x) + std::abs(w.pts[2].y - w.pts[0].y) + 1;
+  }
+  std::istringstream background_in(wire_lines(background));
+  read_wires(background_in, background, occupancy);
+
+  wire_set_t wires(opts.num_wires);
+  for (Wire &w : wires)
+    w = random_wire(gen, opts.dim, opts.span);
+  const std::string input_path = "outputs/microbench_input.txt";
+  const std::string lines = wire_lines(wires);
+  {
+    std::ofstream out(input_path);
+    out << opts.dim << ' ' << opts.dim << '\n' << wires.size() << '\n' << lines;
+  }
+  std::istringstream wires_in(lines);
+  read_wires(wires_in, wires, occupancy);
+  wire_set_t all_wires = background;
+  all_wires.insert(all_wires.end(), wires.begin(), wires.end());
+
+  // the first routes of every wire, for the kernels that score candidates
+  const long long per_wire = 64;
+  wire_set_t candidates;
+  long long candidate_cells = 0;
+  for (const Wire &w : wires) {
+    const Point start = w.pts[0], end = w.pts[w.num_pts - 1];
+    const long long n = std::min(per_wire, count_routes(start, end));
+    for (long long i = 0; i < n; i++)
+      candidates.push_back(route_at(start, end, i));
+    candidate_cells += n * wire_length(w);
+  }
+  long long wire_cells = 0;
+  for (const Wire &w : wires)
+    wire_cells += wire_length(w);
+
+  std::cout << "Board: " << opts.dim << 'x' << opts.dim << ' '
+            << (opts.sparse ? "sparse" : "dense") << ", span " << opts.span
+            << ", congestion " << opts.congestion << " (" << background.size()
+            << " background wires), " << wires.size() << " wires, "
+            << candidates.size() << " candidates\n";
+  std::cout << std::left << std::setw(20) << "kernel" << std::right
+            << std::setw(14) << "ns/op" << std::setw(14) << "Mcells/sec"
+            << std::setw(12) << "allocs/op" << '\n';
+
+  Wire empty{};
+  volatile long long sink = 0;   // keeps results alive
+  const std::vector<bench_t> benches = {
+    { "get_all_wires", [&]() -> bench_work_t {
+        long long cells = 0;
+        for (const Wire &w : wires) {
+          Point start = w.pts[0], end = w.pts[w.num_pts - 1];
+          wire_set_t routes = get_all_wires(start, end, opts.num_threads);
+          cells += routes.size() * wire_length(w);
+        }
+        return { (long long)wires.size(), cells };
+      } },
+    { "route_at", [&]() -> bench_work_t {
+        long long n = 0, cells = 0;
+        for (const Wire &w : wires) {
+          const Point start = w.pts[0], end = w.pts[w.num_pts - 1];
+          const long long routes = count_routes(start, end);
+          for (long long i = 0; i < routes; i++)
+            sink = sink + route_at(start, end, i).num_pts;
+          n += routes;
+          cells += routes * wire_length(w);
+        }
+        return { n, cells };
+      } },
+    { "cost_for_path", [&]() -> bench_work_t {
+        const Grid &occ = occupancy;
+        long long total = 0;
+        for (const Wire &c : candidates)
+          total += cost_for_path<quadratic_cost>(empty, c, occ);
+        sink = sink + total;
+        return { (long long)candidates.size(), candidate_cells };
+      } },
+    { "reroute", [&]() -> bench_work_t {
+        for (const Wire &w : wires) {
+          reroute(w, empty, occupancy);
+          reroute(empty, w, occupancy);
+        }
+        return { 2 * (long long)wires.size(), 2 * wire_cells };
+      } },
+    { "wire_iterator", [&]() -> bench_work_t {
+        long long total = 0;
+        for (const Wire &c : candidates)
+          for (const Point &p : c)
+            total += p.x + p.y;
+        sink = sink + total;
+        return { (long long)candidates.size(), candidate_cells };
+      } },
+    { "validate", [&]() -> bench_work_t {
+        wr_checker checker(all_wires, occupancy);
+        sink = sink + checker.validate(true);
+        return { 1, (long long)opts.dim * opts.dim };
+      } },
+    { "parse", [&]() -> bench_work_t {
+        std::ifstream fin(input_path);
+        int dim_x, dim_y, num_wires;
+        fin >> dim_x >> dim_y >> num_wires;
+        wire_set_t parsed(num_wires);
+        Grid occ = make_grid<Grid>(dim_x, dim_y);
+        read_wires(fin, parsed, occ);
+        return { num_wires, wire_cells };
+      } },
+    { "write_output", [&]() -> bench_work_t {
+        write_output(wires, wires.size(), occupancy, opts.dim, opts.dim,
+                     "outputs/microbench_wire_output.txt",
+                     "outputs/microbench_occ_output.txt");
+        return { 1, (long long)opts.dim * opts.dim };
+      } },
+  };
+
+  for (const bench_t &b : benches) {
+    if (std::string(b.name).find(opts.filter) != std::string::npos)
+      run_bench(b, opts);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bench_opts_t opts;
+  const char *usage = " [-d dim] [-s span] [-k congestion] [-w num_wires] "
+                      "[-W warmup] [-r reps] [-n num_threads] [-S seed] "
+                      "[-g dense|sparse] [-b filter]\n";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:s:k:w:W:r:n:S:g:b:")) != -1) {
+    switch (opt) {
+    case 'd':
+      opts.dim = atoi(optarg);
+      break;
+    case 's':
+      opts.span = atoi(optarg);
+      break;
+    case 'k':
+      opts.congestion = atof(optarg);
+      break;
+    case 'w':
+      opts.num_wires = atoi(optarg);
+      break;
+    case 'W':
+      opts.warmup = atoi(optarg);
+      break;
+    case 'r':
+      opts.reps = atoi(optarg);
+      break;
+    case 'n':
+      opts.num_threads = atoi(optarg);
+      break;
+    case 'S':
+      opts.seed = atoi(optarg);
+      break;
+    case 'g':
+      if (std::string(optarg) == "sparse")
+        opts.sparse = true;
+      else if (std::string(optarg) != "dense")
+        opts.dim = 0; // reported as a usage error below
+      break;
+    case 'b':
+      opts.filter = optarg;
+      break;
+    default:
+      std::cerr << "Usage: " << argv[0] << usage;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (opts.dim <= 0 || opts.span <= 0 || opts.congestion < 0 || opts.num_wires <= 0 ||
+      opts.warmup < 0 || opts.reps <= 0 || opts.num_threads <= 0) {
+    std::cerr << "Usage: " << argv[0] << usage;
+    exit(EXIT_FAILURE);
+  }
+
+  if (opts.sparse)
+    run_suite<tiled_grid_t>(opts);
+  else
+    run_suite<matrix_t>(opts);
+}
@@ -0,0 +1,223 @@
+/**
+ * Occupancy grid backends: the dense matrix_t and the sparse tiled_grid_t
+ */
+
+#ifndef __OCCGRID_H__
+#define __OCCGRID_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+#define TILE_CELLS (TILE_SIZE * TILE_SIZE)
+
+typedef std::vector<std::vector<int>> matrix_t;
+
+/* Sparse occupancy grid made of TILE_SIZE x TILE_SIZE tiles.
+
+A tile is only allocated the first time one of its cells is written, so
+memory scales with the routed area instead of the board area. Until then its
+directory entry points at a shared all-zero tile, which makes a read a shift,
+a directory load and an index with no branch, cheap enough for cost_for_path.
+Tiles are claimed with a compare-and-swap, so threads may write to disjoint
+cells of the same fresh tile concurrently.
+
+grid[y][x] works just like it does on matrix_t; on a non-const grid it
+returns a reference and allocates the tile, so read through a const grid
+when only reading.
+*/
+class tiled_grid_t {
+public:
+  int dim_x = 0, dim_y = 0;
+  int tiles_x = 0, tiles_y = 0;
+
+  struct const_row_t {
+    const std::atomic<int *> *dir;
+    int off;
+    int operator[](int x) const {
+      return dir[x >> TILE_SHIFT].load(std::memory_order_relaxed)[off | (x & TILE_MASK)];
+    }
+  };
+
+  struct row_t {
+    tiled_grid_t *grid;
+    int y;
+    int &operator[](int x) const {
+      int *tile = grid->tile_for_write((y >> TILE_SHIFT) * grid->tiles_x + (x >> TILE_SHIFT));
+      return tile[((y & TILE_MASK) << TILE_SHIFT) | (x & TILE_MASK)];
+    }
+  };
+
+  tiled_grid_t() {}
+  tiled_grid_t(int dim_x, int dim_y)
+      : dim_x(dim_x), dim_y(dim_y), tiles_x((dim_x + TILE_MASK) >> TILE_SHIFT),
+        tiles_y((dim_y + TILE_MASK) >> TILE_SHIFT),
+        dir(new std::atomic<int *>[size_t(tiles_x) * tiles_y]) {
+    for (size_t t = 0; t < num_tiles(); t++)
+      dir[t].store(zero_tile(), std::memory_order_relaxed);
+  }
+  tiled_grid_t(const tiled_grid_t &o) : tiled_grid_t(o.dim_x, o.dim_y) {
+    copy_tiles(o);
+  }
+  tiled_grid_t(tiled_grid_t &&o) noexcept
+      : dim_x(o.dim_x), dim_y(o.dim_y), tiles_x(o.tiles_x), tiles_y(o.tiles_y),
+        dir(std::move(o.dir)), allocated(o.allocated.load()) {
+    o.dim_x = o.dim_y = o.tiles_x = o.tiles_y = 0;
+  }
+  tiled_grid_t &operator=(const tiled_grid_t &o) {
+    if (this != &o) {
+      release();
+      dim_x = o.dim_x;
+      dim_y = o.dim_y;
+      tiles_x = o.tiles_x;
+      tiles_y = o.tiles_y;
+      dir.reset(new std::atomic<int *>[num_tiles()]);
+      for (size_t t = 0; t < num_tiles(); t++)
+        dir[t].store(zero_tile(), std::memory_order_relaxed);
+      copy_tiles(o);
+    }
+    return *this;
+  }
+  ~tiled_grid_t() { release(); }
+
+  const_row_t operator[](int y) const {
+    return { &dir[size_t(y >> TILE_SHIFT) * tiles_x], (y & TILE_MASK) << TILE_SHIFT };
+  }
+  row_t operator[](int y) { return { this, y }; }
+
+  size_t num_tiles() const { return size_t(tiles_x) * tiles_y; }
+  size_t allocated_tiles() const { return allocated.load(std::memory_order_relaxed); }
+
+  // tile t in row-major tile order, the shared zero tile when untouched
+  const int *tile(size_t t) const { return dir[t].load(std::memory_order_relaxed); }
+  bool has_tile(size_t t) const { return tile(t) != zero_tile(); }
+
+  int *tile_for_write(size_t t) {
+    int *cur = dir[t].load(std::memory_order_acquire);
+    if (cur != zero_tile())
+      return cur;
+    int *fresh = new int[TILE_CELLS]();
+    if (dir[t].compare_exchange_strong(cur, fresh, std::memory_order_acq_rel)) {
+      allocated.fetch_add(1, std::memory_order_relaxed);
+      return fresh;
+    }
+    delete[] fresh;   // another thread got there first
+    return cur;
+  }
+
+  // drop every tile, back to an all-zero grid
+  void clear() {
+    for (size_t t = 0; t < num_tiles(); t++) {
+      int *cur = dir[t].load(std::memory_order_relaxed);
+      if (cur != zero_tile())
+        delete[] cur;
+      dir[t].store(zero_tile(), std::memory_order_relaxed);
+    }
+    allocated.store(0, std::memory_order_relaxed);
+  }
+
+  static int *zero_tile() {
+    static int zeros[TILE_CELLS] = {};
+    return zeros;
+  }
+
+private:
+  std::unique_ptr<std::atomic<int *>[]> dir;
+  std::atomic<size_t> allocated{0};
+
+  void copy_tiles(const tiled_grid_t &o) {
+    for (size_t t = 0; t < num_tiles(); t++) {
+      if (o.has_tile(t))
+        std::copy(o.tile(t), o.tile(t) + TILE_CELLS, tile_for_write(t));
+    }
+  }
+  void release() {
+    if (dir)
+      clear();
+  }
+};
+
+/* The helpers below give both backends the same interface for whole-grid
+work, so code templated on the grid type never needs to know which one it
+has. */
+
+template <typename Grid> Grid make_grid(int dim_x, int dim_y);
+template <> inline matrix_t make_grid<matrix_t>(int dim_x, int dim_y) {
+  return matrix_t(dim_y, std::vector<int>(dim_x, 0));
+}
+template <> inline tiled_grid_t make_grid<tiled_grid_t>(int dim_x, int dim_y) {
+  return tiled_grid_t(dim_x, dim_y);
+}
+
+inline int grid_dim_x(const matrix_t &g) { return g[0].size(); }
+inline int grid_dim_y(const matrix_t &g) { return g.size(); }
+inline int grid_dim_x(const tiled_grid_t &g) { return g.dim_x; }
+inline int grid_dim_y(const tiled_grid_t &g) { return g.dim_y; }
+
+inline void clear_grid(matrix_t &g) {
+  for (auto &row : g)
+    std::fill(row.begin(), row.end(), 0);
+}
+inline void clear_grid(tiled_grid_t &g) { g.clear(); }
+
+// calls f(x, y, count) for every cell that can be nonzero; on a tiled grid
+// that is only the cells of allocated tiles
+template <typename F> void for_each_cell(const matrix_t &g, F f) {
+  for (int y = 0; y < grid_dim_y(g); y++)
+    for (int x = 0; x < grid_dim_x(g); x++)
+      f(x, y, g[y][x]);
+}
+template <typename F> void for_each_cell(const tiled_grid_t &g, F f) {
+  for (size_t t = 0; t < g.num_tiles(); t++) {
+    if (!g.has_tile(t)) continue;
+    const int *tile = g.tile(t);
+    const int tx = (t % g.tiles_x) << TILE_SHIFT, ty = (t / g.tiles_x) << TILE_SHIFT;
+    const int x_end = std::min(TILE_SIZE, g.dim_x - tx);
+    const int y_end = std::min(TILE_SIZE, g.dim_y - ty);
+    for (int y = 0; y < y_end; y++)
+      for (int x = 0; x < x_end; x++)
+        f(tx + x, ty + y, tile[(y << TILE_SHIFT) | x]);
+  }
+}
+
+// calls f(x, y, a_count, b_count) for every cell where either grid can be
+// nonzero; a and b must have the same dimensions
+template <typename F> void for_each_cell_pair(const matrix_t &a, const matrix_t &b, F f) {
+  for (int y = 0; y < grid_dim_y(a); y++)
+    for (int x = 0; x < grid_dim_x(a); x++)
+      f(x, y, a[y][x], b[y][x]);
+}
+template <typename F>
+void for_each_cell_pair(const tiled_grid_t &a, const tiled_grid_t &b, F f) {
+  for (size_t t = 0; t < a.num_tiles(); t++) {
+    if (!a.has_tile(t) && !b.has_tile(t)) continue;
+    const int *ta = a.tile(t), *tb = b.tile(t);
+    const int tx = (t % a.tiles_x) << TILE_SHIFT, ty = (t / a.tiles_x) << TILE_SHIFT;
+    const int x_end = std::min(TILE_SIZE, a.dim_x - tx);
+    const int y_end = std::min(TILE_SIZE, a.dim_y - ty);
+    for (int y = 0; y < y_end; y++)
+      for (int x = 0; x < x_end; x++)
+        f(tx + x, ty + y, ta[(y << TILE_SHIFT) | x], tb[(y << TILE_SHIFT) | x]);
+  }
+}
+
+// calls f(counts, n, all_zero) for consecutive runs covering row y left to
+// right; untouched tiles come through as all_zero runs
+template <typename F> void for_each_row_run(const matrix_t &g, int y, F f) {
+  f(g[y].data(), grid_dim_x(g), false);
+}
+template <typename F> void for_each_row_run(const tiled_grid_t &g, int y, F f) {
+  const size_t row_tiles = size_t(y >> TILE_SHIFT) * g.tiles_x;
+  const int off = (y & TILE_MASK) << TILE_SHIFT;
+  for (int tx = 0; tx < g.tiles_x; tx++) {
+    const int n = std::min(TILE_SIZE, g.dim_x - (tx << TILE_SHIFT));
+    f(g.tile(row_tiles + tx) + off, n, !g.has_tile(row_tiles + tx));
+  }
+}
+
+#endif
@@ -50,8 +50,8 @@ validate_wire_t &validate_wire_t::cleanup(void) {
   return *this;
 }
 
-void wr_checker::validate() const {
-  std::vector occ_computed(dim_y, std::vector<int>(dim_x));
+template <typename Grid> int wr_checker<Grid>::validate(bool quiet) const {
+  Grid occ_computed = make_grid<Grid>(dim_x, dim_y);
 
   for (int wi = 0; wi < nwires; wi++) {
     const auto &w = wires[wi];
@@ -80,16 +80,20 @@ void wr_checker::validate() const {
     } while (cur_point < wire.num_pts - 1);
   }
   int total = 0;
-  for (int i = 0; i < dim_y; i++) {
-    for (int j = 0; j < dim_x; j++) {
-      if (occ_computed[i][j] != occupancies[i][j]) {
-        if (total++ < COST_REPORT_DEPTH)
-          printf("Occupancy Matrix: Values mismatch at (%d, %d)\n", j, i);
-      }
+  for_each_cell_pair(occ_computed, occupancies, [&](int j, int i, int want, int got) {
+    if (want != got) {
+      if (total++ < COST_REPORT_DEPTH && !quiet)
+        printf("Occupancy Matrix: Values mismatch at (%d, %d)\n", j, i);
     }
-  }
+  });
+  if (quiet)
+    return total;
   if (total > 0)
     printf(RED "Validate: %d total mismatches.\n" RESET, total);
   else
     printf(GREEN "Validate Passed: no mismatches.\n" RESET);
+  return total;
 }
+
+template struct wr_checker<matrix_t>;
+template struct wr_checker<tiled_grid_t>;
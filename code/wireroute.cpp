@@ -4,25 +4,48 @@
  */
 
 #include "wireroute.h"
+#include "asyncio.h"
+#include "checkpoint.h"
+#include "costpolicy.h"
+#include "heatmap.h"
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <getopt.h>
 #include <omp.h>
 #include <unistd.h>
 
-#define MAX_COST 999999999
+#define MIN_TEMP 0.5
+#define MAZE_MIN_MARGIN 16
+#define MAZE_MAX_WINDOW_CELLS (1 << 21)
+#define BARRIER_SPINS 1024
+#define AUTOTUNE_DEFAULT_SAMPLES 64
+#define AUTOTUNE_MIN_SAMPLES 8
+#define AUTOTUNE_MIN_ROUTES_PER_THREAD 4096
+#define AUTOTUNE_MIN_WIRES_PER_THREAD 64
+#define BUDGET_REFINE_SEEDS 4
+#define BUDGET_AUDIT_WIRES 64
+#define PIPELINE_CHUNK 256
 
 typedef std::vector<Wire> wire_set_t;
-typedef std::vector<std::vector<int>> matrix_t;
 
 inline bool on_same_line(Point start, Point end)  {
   return start.x == end.x || start.y == end.y;
@@ -125,18 +148,100 @@ wire_set_t get_all_wires(Point &start, Point &end, int num_threads)
   return ws;
 }
 
+// number of <=3-bend routes between start and end, counted in the order
+// route_at hands them out: the two 1-bend routes, the 2-bend routes bending
+// on a column then on a row, then every (j, k) 3-bend pair (horizontal first)
+long long count_routes(Point start, Point end) {
+  if (on_same_line(start, end)) return 1;
+  long long nx = std::abs(end.x - start.x) - 1;
+  long long ny = std::abs(end.y - start.y) - 1;
+  return 2 + nx + ny + 2 * nx * ny;
+}
+
+// the idx-th route of count_routes(start, end); unlike get_all_wires this
+// also walks the bend points for wires running right-to-left or top-down
+Wire route_at(Point start, Point end, long long idx) {
+  Wire w{};
+  if (on_same_line(start, end)) {
+    w.num_pts = 2;
+    w.pts[0] = start;
+    w.pts[1] = end;
+    return w;
+  }
+  int sx = sgn(end.x - start.x);
+  int sy = sgn(end.y - start.y);
+  long long nx = std::abs(end.x - start.x) - 1;
+  long long ny = std::abs(end.y - start.y) - 1;
+
+  w.pts[0] = start;
+  if (idx < 2) {
+    w.num_pts = 3;
+    w.pts[1] = idx == 0 ? Point{ end.x, start.y } : Point{ start.x, end.y };
+    w.pts[2] = end;
+    return w;
+  }
+  idx -= 2;
+
+  if (idx < nx + ny) {
+    w.num_pts = 4;
+    if (idx < nx) {
+      int a = start.x + sx * int(idx + 1);
+      w.pts[1] = { a, start.y };
+      w.pts[2] = { a, end.y };
+    } else {
+      int b = start.y + sy * int(idx - nx + 1);
+      w.pts[1] = { start.x, b };
+      w.pts[2] = { end.x, b };
+    }
+    w.pts[3] = end;
+    return w;
+  }
+  idx -= nx + ny;
+
+  long long pair = idx / 2;
+  int j = start.x + sx * int(pair / ny + 1);
+  int k = start.y + sy * int(pair % ny + 1);
+  w.num_pts = 5;
+  if (idx % 2 == 0) {
+    // double-horizontal
+    w.pts[1] = { j, start.y };
+    w.pts[2] = { j, k };
+    w.pts[3] = { end.x, k };
+  } else {
+    // double-vertical
+    w.pts[1] = { start.x, k };
+    w.pts[2] = { j, k };
+    w.pts[3] = { j, end.y };
+  }
+  w.pts[4] = end;
+  return w;
+}
+
 // calculate the cost for a new wire n, ignoring a past wire o,
 // given the occupancy matrix
-int cost_for_path(const Wire &o, const Wire &n, const matrix_t &occupancy) {
-  int cost = 0;
+template <typename Cost, typename Grid>
+typename Cost::value_t cost_for_path(const Wire &o, const Wire &n, const Grid &occupancy) {
+  typename Cost::value_t cost = Cost::route(n);
+  for (const Point &p: n) {
+    cost += Cost::cell(occupancy[p.y][p.x]);
+  }
+  return cost;
+}
+
+// how much laying wire n on top of occupancy raises the board cost that
+// print_stats reports: total(occ+1) - total(occ) per cell
+template <typename Cost, typename Grid>
+long long marginal_cost(const Wire &n, const Grid &occupancy) {
+  long long cost = 0;
   for (const Point &p: n) {
     int occ = occupancy[p.y][p.x];
-    cost += (occ + 1) * (occ + 1);
+    cost += Cost::total(occ + 1) - Cost::total(occ);
   }
   return cost;
 }
 
-void reroute(Wire old, Wire n, matrix_t &occupancy) {
+template <typename Grid>
+void reroute(Wire old, Wire n, Grid &occupancy) {
   for (Point p: old)
   {
     occupancy[p.y][p.x]--;
@@ -150,134 +255,1199 @@ void reroute(Wire old, Wire n, matrix_t &occupancy) {
   return;
 }
 
+/* Barrier where the last thread to arrive runs a serial step before letting
+the others go, so "wait for everyone, then one thread updates shared state"
+costs a single synchronization instead of two. Waiters spin briefly and then
+yield; when the team is larger than the machine they sleep on a condition
+variable instead, since spinning would only steal the last arriver's core. */
+struct combining_barrier_t {
+  std::atomic<int> arrived{0};
+  std::atomic<int> generation{0};
+  const int team;
+  const bool blocking;
+  std::mutex lock;
+  std::condition_variable released;
+
+  explicit combining_barrier_t(int team)
+      : team(team), blocking(team > omp_get_num_procs()) {}
+
+  template <typename F> void arrive(F last) {
+    const int gen = generation.load(std::memory_order_acquire);
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) == team - 1) {
+      last();
+      arrived.store(0, std::memory_order_relaxed);
+      if (blocking) {
+        std::lock_guard<std::mutex> guard(lock);
+        generation.store(gen + 1, std::memory_order_release);
+        released.notify_all();
+      } else {
+        generation.store(gen + 1, std::memory_order_release);
+      }
+      return;
+    }
+    if (blocking) {
+      std::unique_lock<std::mutex> guard(lock);
+      released.wait(guard, [&]() {
+        return generation.load(std::memory_order_acquire) != gen;
+      });
+      return;
+    }
+    for (int spins = 0; generation.load(std::memory_order_acquire) == gen; spins++) {
+      if (spins >= BARRIER_SPINS)
+        std::this_thread::yield();
+    }
+  }
+};
+
+// per-thread best candidate, padded to its own cache line
+template <typename Cost>
+struct alignas(64) scan_slot_t {
+  typename Cost::value_t cost;
+  long long idx;
+};
+
+// BUDGETED SEARCH
+// -B: how many routes a wire may score, a fixed count or per cell of its
+// length, whichever is larger; wires with fewer routes are scanned in full
+struct search_budget_t {
+  long long routes = 0;
+  double per_cell = 0;
+  bool enabled() const { return routes > 0 || per_cell > 0; }
+  long long for_wire(Point start, Point end) const {
+    if (!enabled()) return std::numeric_limits<long long>::max();
+    const int length = std::abs(end.x - start.x) + std::abs(end.y - start.y) + 1;
+    return std::max(routes, (long long)std::ceil(per_cell * length));
+  }
+};
+
+/* Picks a cheap route for wire from at most budget scored routes, for route
+spaces too big to scan in full. The 1- and 2-bend routes are always scored.
+Half of what is left samples the 3-bend (j, k) plane, one random pair per
+stratum of an evenly split grid, in both orientations. The other half refines
+the best BUDGET_REFINE_SEEDS samples by pattern search: step to the best
+neighbour a stratum away along j or k, and halve the step when no neighbour
+improves. Parts of a team call this with their own part of parts and a
+private generator; they share the work and each reports its best in slot. */
+template <typename Cost, typename Grid>
+void budgeted_scan(const Wire &wire, Point start, Point end, const Grid &occupancy,
+                   long long budget, std::mt19937 &gen, int part, int parts,
+                   scan_slot_t<Cost> &slot) {
+  typedef typename Cost::value_t cost_t;
+  slot.cost = std::numeric_limits<cost_t>::max();
+  slot.idx = 0;
+  auto score = [&](long long i) {
+    cost_t cost = cost_for_path<Cost>(wire, route_at(start, end, i), occupancy);
+    if (cost < slot.cost || (cost == slot.cost && i < slot.idx)) {
+      slot.cost = cost;
+      slot.idx = i;
+    }
+    return cost;
+  };
+
+  const long long num_routes = count_routes(start, end);
+  const long long nx = std::abs(end.x - start.x) - 1;
+  const long long ny = std::abs(end.y - start.y) - 1;
+  const long long fixed = nx < 0 || ny < 0 ? num_routes : 2 + nx + ny;
+  const long long scan = num_routes <= budget || nx <= 0 || ny <= 0 ? num_routes : fixed;
+  for (long long i = scan * part / parts; i < scan * (part + 1) / parts; i++)
+    score(i);
+  if (scan == num_routes) return;
+
+  // route_at index of the 3-bend route bending at the jj-th column and the
+  // kk-th row, horizontal first when o is 0
+  auto index = [&](long long jj, long long kk, int o) { return fixed + 2 * (jj * ny + kk) + o; };
+  const long long spare = std::max(budget - fixed, 4LL * parts);
+  const long long strata = std::max(1LL, spare / 4);
+  const long long sj = std::clamp((long long)std::llround(std::sqrt(double(strata) * nx / ny)), 1LL, nx);
+  const long long sk = std::clamp(strata / sj, 1LL, ny);
+
+  struct sample_t { cost_t cost; long long jj, kk; int o; };
+  std::vector<sample_t> seeds;
+  for (long long s = part; s < sj * sk; s += parts) {
+    const long long a = s / sk, b = s % sk;
+    const long long jj = a * nx / sj + std::uniform_int_distribution<long long>(
+        0, std::max(0LL, (a + 1) * nx / sj - a * nx / sj - 1))(gen);
+    const long long kk = b * ny / sk + std::uniform_int_distribution<long long>(
+        0, std::max(0LL, (b + 1) * ny / sk - b * ny / sk - 1))(gen);
+    for (int o = 0; o < 2; o++) {
+      seeds.push_back({ score(index(jj, kk, o)), jj, kk, o });
+      // keep only the best few, cheapest first
+      std::sort(seeds.begin(), seeds.end(), [](const sample_t &x, const sample_t &y) {
+        return x.cost < y.cost;
+      });
+      if (seeds.size() > BUDGET_REFINE_SEEDS)
+        seeds.pop_back();
+    }
+  }
+
+  long long refine = spare / 2 / parts / std::max<size_t>(1, seeds.size());
+  for (sample_t cur : seeds) {
+    long long step_j = std::max(1LL, nx / sj / 2), step_k = std::max(1LL, ny / sk / 2);
+    long long left = refine;
+    while (left > 0) {
+      const long long moves[4][2] = { { step_j, 0 }, { -step_j, 0 }, { 0, step_k }, { 0, -step_k } };
+      sample_t next = cur;
+      for (const auto &m : moves) {
+        const long long jj = cur.jj + m[0], kk = cur.kk + m[1];
+        if (jj < 0 || jj >= nx || kk < 0 || kk >= ny || left-- <= 0) continue;
+        cost_t cost = score(index(jj, kk, cur.o));
+        if (cost < next.cost)
+          next = { cost, jj, kk, cur.o };
+      }
+      if (next.cost < cur.cost) {
+        cur = next;
+      } else if (step_j > 1 || step_k > 1) {
+        step_j = std::max(1LL, step_j / 2);
+        step_k = std::max(1LL, step_k / 2);
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+/* -G: how far the budgeted search lands from the exhaustive optimum. Up to
+BUDGET_AUDIT_WIRES evenly spaced wires whose route spaces exceed their budget
+are lifted off the final layout one at a time, and the best route found
+within budget is compared with the best of a full scan on the grid as it
+stands. */
+template <typename Cost, typename Grid>
+void budget_gap_report(Grid &occupancy, wire_set_t &wires, int num_threads,
+                       const search_budget_t &budget, std::ostream &log = std::cout) {
+  typedef typename Cost::value_t cost_t;
+  Wire empty{};
+  std::vector<int> over;
+  for (int i = 0; i < (int)wires.size(); i++) {
+    const Point start = wires[i].pts[0], end = wires[i].pts[wires[i].num_pts - 1];
+    if (count_routes(start, end) > budget.for_wire(start, end))
+      over.push_back(i);
+  }
+  log << "Budgeted wires: " << over.size() << " of " << wires.size() << '\n';
+  if (over.empty()) return;
+
+  std::mt19937 gen(BUDGET_AUDIT_WIRES);
+  const size_t stride = std::max<size_t>(1, over.size() / BUDGET_AUDIT_WIRES);
+  double sum_gap = 0, worst_gap = 0;
+  long long budget_routes = 0, all_routes = 0;
+  int audited = 0;
+  for (size_t i = 0; i < over.size() && audited < BUDGET_AUDIT_WIRES; i += stride, audited++) {
+    Wire &wire = wires[over[i]];
+    const Point start = wire.pts[0], end = wire.pts[wire.num_pts - 1];
+    const long long num_routes = count_routes(start, end);
+    reroute(wire, empty, occupancy);
+
+    scan_slot_t<Cost> approx;
+    budgeted_scan(wire, start, end, occupancy, budget.for_wire(start, end), gen, 0, 1, approx);
+    cost_t exact = std::numeric_limits<cost_t>::max();
+    #pragma omp parallel for schedule(static) num_threads(num_threads) reduction(min: exact)
+    for (long long r = 0; r < num_routes; r++)
+      exact = std::min(exact, cost_for_path<Cost>(wire, route_at(start, end, r), occupancy));
+    reroute(empty, wire, occupancy);
+
+    const double gap = double(approx.cost - exact) / double(exact);
+    sum_gap += gap;
+    worst_gap = std::max(worst_gap, gap);
+    budget_routes += budget.for_wire(start, end);
+    all_routes += num_routes;
+  }
+  log << "Budget gap vs exhaustive (" << audited << " wires): mean "
+      << 100 * sum_gap / audited << "%, worst " << 100 * worst_gap
+      << "%, budget " << budget_routes << " of " << all_routes << " routes\n";
+}
+
 // WITHIN WIRES SOLUTION
+/* One team lives for the whole solve. For each wire every thread scores its
+own slice of the route index space straight from route_at, without building
+a candidate list, then arrives at the combining barrier. The last thread to
+arrive picks the winner, lays it down, and unroutes the next wire before it
+releases the team; at an iteration boundary it also takes the snapshot. */
+template <typename Cost, typename Grid>
 void solve_within_wires(
-    matrix_t &occupancy,
+    Grid &occupancy,
     wire_set_t &wires,
     int dim_x, int dim_y, int num_wires,
     int num_threads, float prob,
-    int iters) {
+    int iters, std::ostream &log = std::cout,
+    const search_budget_t &budget = search_budget_t(),
+    unsigned seed = std::random_device()(),
+    const snapshot_ctl_t &snap = snapshot_ctl_t()) {
 
     Wire empty{};
-    std::cout << "solving within wires\n";
-    for (int t = 0; t < iters; t++) {
-      // TIME STEP LOOP
-      for (Wire &wire: wires) { // holy shit auto is a thing
-        Point &start = wire.pts[0];
-        Point &end = wire.pts[wire.num_pts - 1];
-        if (on_same_line(start, end)) continue;
-        wire_set_t all_wires;
-        int min_cost;
-        Wire best_path;
-        reroute(wire, empty, occupancy); // unroute the normal wire
-        min_cost = MAX_COST;
-        best_path = wire;
-        all_wires = get_all_wires(start, end, num_threads);
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-
-        float p = (double(std::rand()) / (RAND_MAX));
-        if (0.f <= p && p <= prob)
-          best_path = all_wires[std::uniform_int_distribution<>(
-                  0, all_wires.size()-1)(gen)];
-        else {
-          #pragma omp parallel for schedule(static) num_threads(num_threads)
-          for (size_t i = 0; i < all_wires.size(); i++) {
-            const Wire new_path = all_wires[i];
-            int new_cost;
-            new_cost = cost_for_path(wire, new_path, occupancy);
-            if (new_cost < min_cost  || (new_cost == min_cost && new_path.num_pts >= wire.num_pts))
-            #pragma omp critical
-            {
-              min_cost = new_cost;
-              best_path = new_path;
+    log << "solving within wires\n";
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> coin(0.f, 1.f);
+
+    // straight wires have a single route, never touch them
+    std::vector<int> todo;
+    for (int i = 0; i < (int)wires.size(); i++) {
+      if (!on_same_line(wires[i].pts[0], wires[i].pts[wires[i].num_pts - 1]))
+        todo.push_back(i);
+    }
+    if (todo.empty()) return;
+
+    const long long steps = (long long)iters * todo.size();
+    // position in the TIME STEP x wire sequence
+    long long step = (long long)snap.start_iter * todo.size();
+    if (snap.in) {
+      snap.in->wires(wires);
+      snap.in->grid(occupancy);
+      snap.in->rng(gen);
+    }
+    bool random_pick = false;    // this wire takes a random route instead
+    typedef typename Cost::value_t cost_t;
+    // the scan is split into num_threads parts whatever team is granted,
+    // each with its own -B generator, so a short team routes the same
+    std::vector<scan_slot_t<Cost>> slots(num_threads);
+    std::vector<std::mt19937> scan_gens(num_threads);
+    std::vector<double> compute_time(num_threads, 0), sync_time(num_threads, 0);
+    double serial_time = 0;
+    int team = num_threads;
+    std::unique_ptr<combining_barrier_t> barrier;
+
+    // unroute the first wire and decide how it will be picked
+    auto start_step = [&]() {
+      reroute(wires[todo[step % todo.size()]], empty, occupancy);
+      random_pick = coin(gen) <= prob;
+    };
+    if (step < steps)
+      start_step();
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+      const int tid = omp_get_thread_num();
+      // OMP_THREAD_LIMIT or OMP_DYNAMIC may grant fewer threads than asked
+      // for, so the barrier is sized once the team exists and each thread
+      // takes the parts tid, tid + team, ...
+      #pragma omp single
+      {
+        team = omp_get_num_threads();
+        barrier = std::make_unique<combining_barrier_t>(team);
+      }
+      long long scan_iter = -1;
+      while (step < steps) {
+        double t0 = omp_get_wtime();
+        if (step / (long long)todo.size() != scan_iter) {
+          scan_iter = step / todo.size();
+          for (int p = tid; p < num_threads; p += team)
+            scan_gens[p] = iteration_gen(seed, scan_iter, p);
+        }
+        const Wire &wire = wires[todo[step % todo.size()]];
+        const Point start = wire.pts[0];
+        const Point end = wire.pts[wire.num_pts - 1];
+        const long long num_routes = count_routes(start, end);
+        const long long route_budget = budget.for_wire(start, end);
+
+        for (int p = tid; p < num_threads; p += team) {
+          scan_slot_t<Cost> &mine = slots[p];
+          mine.cost = std::numeric_limits<cost_t>::max();
+          mine.idx = 0;
+          if (!random_pick && num_routes > route_budget) {
+            budgeted_scan(wire, start, end, occupancy, route_budget, scan_gens[p], p,
+                          num_threads, mine);
+          } else if (!random_pick) {
+            const long long lo = num_routes * p / num_threads;
+            const long long hi = num_routes * (p + 1) / num_threads;
+            for (long long i = lo; i < hi; i++) {
+              cost_t new_cost = cost_for_path<Cost>(wire, route_at(start, end, i), occupancy);
+              if (new_cost < mine.cost) {
+                mine.cost = new_cost;
+                mine.idx = i;
+              }
             }
           }
-         }
-
-        if (best_path == wire) {
-          continue;
-        } else {
-          reroute(empty, best_path, occupancy);
-          wire = best_path;
         }
+        double t1 = omp_get_wtime();
+        double serial = 0;
+
+        barrier->arrive([&]() {
+          double s0 = omp_get_wtime();
+          Wire &cur = wires[todo[step % todo.size()]];
+          long long best_idx = 0;
+          if (random_pick) {
+            best_idx = std::uniform_int_distribution<long long>(0, num_routes - 1)(gen);
+          } else {
+            // slots are in index order, so ties keep the lowest index
+            cost_t best_cost = std::numeric_limits<cost_t>::max();
+            for (const scan_slot_t<Cost> &slot : slots) {
+              if (slot.cost < best_cost) {
+                best_cost = slot.cost;
+                best_idx = slot.idx;
+              }
+            }
+          }
+          cur = route_at(start, end, best_idx);
+          reroute(empty, cur, occupancy);
+          ++step;
+          if (step % todo.size() == 0 && snap.due(step / todo.size(), iters)) {
+            snap.out->save(step / todo.size(), [&](snapshot_out_t &out) {
+              out.wires(wires);
+              out.grid(occupancy);
+              out.rng(gen);
+            });
+          }
+          if (step < steps)
+            start_step();
+          serial = omp_get_wtime() - s0;
+          serial_time += serial;
+        });
+
+        compute_time[tid] += t1 - t0;
+        sync_time[tid] += omp_get_wtime() - t1 - serial;
       }
     }
+
+    double compute = 0, sync = 0;
+    for (int tid = 0; tid < team; tid++) {
+      compute += compute_time[tid] / team;
+      sync += sync_time[tid] / team;
+    }
+    log << "Within-wire scan time per thread (sec): " << compute << '\n';
+    log << "Within-wire sync wait per thread (sec): " << sync << '\n';
+    log << "Within-wire serial reroute time (sec): " << serial_time << '\n';
 }
 
 
 // ACROSS WIRES SOLUTION
+template <typename Cost, typename Grid>
 void solve_across_wires(
-    matrix_t &occupancy,
+    Grid &occupancy,
     wire_set_t &wires,
     int dim_x, int dim_y, int num_wires,
     int num_threads, float prob,
-    int iters, int batch_size) {
+    int iters, int batch_size, std::ostream &log = std::cout,
+    const search_budget_t &budget = search_budget_t(),
+    unsigned seed = std::random_device()(),
+    const snapshot_ctl_t &snap = snapshot_ctl_t()) {
 
     Wire empty{};
-    std::cout << "solving across wires\n";
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
+    log << "solving across wires\n";
+    // guards occupancy updates; owned by this solve so that -F boards
+    // routed side by side never wait on each other's lock
+    std::mutex grid_lock;
+    if (snap.in) {
+      snap.in->wires(wires);
+      snap.in->grid(occupancy);
+    }
 
-    for (int t = 0; t < iters; t++) {
+    // the generators are reseeded every iteration, so the seed and the
+    // iteration are all the random state a snapshot needs
+    for (int t = snap.start_iter; t < iters; t++) {
       // TIME STEP LOOP
-      #pragma omp parallel for schedule(dynamic, batch_size) num_threads(num_threads)
-      for (int i = 0; i < wires.size(); i++) { // holy shit auto is a thing
-        Wire &wire = wires[i];
-        Point &start = wire.pts[0];
-        Point &end = wire.pts[wire.num_pts - 1];
-        if (on_same_line(start, end)) continue;
-        wire_set_t all_wires;
-        int min_cost;
-        Wire best_path;
-        #pragma omp critical
+      #pragma omp parallel num_threads(num_threads)
+      {
+        // one generator per thread instead of one shared by the whole team
+        std::mt19937 gen = iteration_gen(seed, t, omp_get_thread_num());
+        #pragma omp for schedule(dynamic, batch_size)
+        for (int i = 0; i < (int)wires.size(); i++) { // holy shit auto is a thing
+          Wire &wire = wires[i];
+          Point &start = wire.pts[0];
+          Point &end = wire.pts[wire.num_pts - 1];
+          if (on_same_line(start, end)) continue;
+          wire_set_t all_wires;
+          typename Cost::value_t min_cost;
+          Wire best_path;
+          {
+            std::lock_guard<std::mutex> guard(grid_lock);
+            reroute(wire, empty, occupancy); // unroute the normal wire
+          }
+          min_cost = std::numeric_limits<typename Cost::value_t>::max();
+          best_path = wire;
+          const long long num_routes = count_routes(start, end);
+          const long long route_budget = budget.for_wire(start, end);
+          if (num_routes > route_budget) {
+            // too many routes to list, sample them within the budget
+            scan_slot_t<Cost> best;
+            if (std::uniform_real_distribution<float>(0.f, 1.f)(gen) <= prob)
+              best.idx = std::uniform_int_distribution<long long>(0, num_routes - 1)(gen);
+            else
+              budgeted_scan(wire, start, end, occupancy, route_budget, gen, 0, 1, best);
+            best_path = route_at(start, end, best.idx);
+            {
+              std::lock_guard<std::mutex> guard(grid_lock);
+              reroute(empty, best_path, occupancy);
+              wire = best_path;
+            }
+            continue;
+          }
+          all_wires = get_all_wires(start, end, num_threads);
+          if (std::uniform_real_distribution<float>(0.f, 1.f)(gen) <= prob)
+            best_path = all_wires[std::uniform_int_distribution<>(
+                    0, all_wires.size()-1)(gen)];
+          else {
+            for (Wire &new_path: all_wires) {
+              typename Cost::value_t new_cost;
+              new_cost = cost_for_path<Cost>(wire, new_path, occupancy);
+              if (new_cost < min_cost)
+              {
+                min_cost = new_cost;
+                best_path = new_path;
+              }
+            }
+          }
+
+          if (best_path == wire) {
+            continue;
+          } else {
+            std::lock_guard<std::mutex> guard(grid_lock);
+            reroute(empty, best_path, occupancy);
+            wire = best_path;
+          }
+        }
+      }
+      if (snap.due(t + 1, iters)) {
+        snap.out->save(t + 1, [&](snapshot_out_t &out) {
+          out.wires(wires);
+          out.grid(occupancy);
+        });
+      }
+    }
+}
+
+// PARALLEL TEMPERING SOLUTION
+// every replica owns a full copy of the wires and the grid and anneals at its
+// own temperature with Metropolis acceptance; after each sweep neighbouring
+// temperatures trade states so good layouts drift down to the cold end
+template <typename Grid>
+struct replica_t {
+  Grid occupancy;
+  wire_set_t wires;
+  long long energy;   // board cost, same as print_stats
+  double temp;
+  std::mt19937 gen;
+};
+
+// one Metropolis sweep over every wire of a replica, proposing a uniformly
+// random <=3-bend route for each
+template <typename Cost, typename Grid>
+void anneal_sweep(replica_t<Grid> &rep) {
+  Wire empty{};
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  for (Wire &wire: rep.wires) {
+    Point start = wire.pts[0];
+    Point end = wire.pts[wire.num_pts - 1];
+    long long num_routes = count_routes(start, end);
+    if (num_routes == 1) continue;
+
+    Wire cand = route_at(start, end,
+        std::uniform_int_distribution<long long>(0, num_routes - 1)(rep.gen));
+    reroute(wire, empty, rep.occupancy);
+    long long delta = marginal_cost<Cost>(cand, rep.occupancy)
+                    - marginal_cost<Cost>(wire, rep.occupancy);
+    if (delta <= 0 || coin(rep.gen) < std::exp(-delta / rep.temp)) {
+      wire = cand;
+      rep.energy += delta;
+    }
+    reroute(empty, wire, rep.occupancy);
+  }
+}
+
+template <typename Cost, typename Grid>
+void solve_tempering(
+    Grid &occupancy,
+    wire_set_t &wires,
+    int dim_x, int dim_y, int num_wires,
+    int num_threads, int iters,
+    int num_replicas, double max_temp, std::ostream &log = std::cout,
+    unsigned seed = std::random_device()(),
+    const snapshot_ctl_t &snap = snapshot_ctl_t()) {
+
+    Wire empty{};
+    log << "solving with parallel tempering\n";
+    std::mt19937 swap_gen(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    long long energy = 0;
+    for_each_cell(occupancy, [&](int x, int y, int count) {
+      energy += Cost::total(count);
+    });
+
+    // geometric ladder from MIN_TEMP to max_temp; ladder[s] is the replica
+    // currently sitting at temperature slot s
+    std::vector<double> temps(num_replicas);
+    std::vector<int> ladder(num_replicas);
+    for (int s = 0; s < num_replicas; s++) {
+      temps[s] = num_replicas == 1 ? MIN_TEMP :
+          MIN_TEMP * std::pow(max_temp / MIN_TEMP, double(s) / (num_replicas - 1));
+      ladder[s] = s;
+    }
+
+    std::vector<replica_t<Grid>> replicas(num_replicas);
+    for (int r = 0; r < num_replicas; r++) {
+      replicas[r].energy = energy;
+      replicas[r].temp = temps[r];
+      replicas[r].gen = iteration_gen(seed, 0, r);
+    }
+
+    wire_set_t best_wires = wires;
+    long long best_energy = energy;
+    int swaps_tried = 0, swaps_done = 0;
+
+    // every replica's generator carries on across sweeps, so a snapshot
+    // holds the whole ensemble; resuming decodes it here, on one thread
+    auto save_state = [&](snapshot_out_t &out) {
+      out.rng(swap_gen);
+      for (int s = 0; s < num_replicas; s++)
+        out.varint(ladder[s]);
+      out.svarint(best_energy);
+      out.wires(best_wires);
+      out.varint(swaps_tried);
+      out.varint(swaps_done);
+      for (const replica_t<Grid> &rep : replicas) {
+        out.svarint(rep.energy);
+        out.f64(rep.temp);
+        out.rng(rep.gen);
+        out.wires(rep.wires);
+        out.grid(rep.occupancy);
+      }
+    };
+    if (snap.in) {
+      snap.in->rng(swap_gen);
+      for (int s = 0; s < num_replicas; s++)
+        ladder[s] = snap.in->varint();
+      best_energy = snap.in->svarint();
+      snap.in->wires(best_wires);
+      swaps_tried = snap.in->varint();
+      swaps_done = snap.in->varint();
+      for (replica_t<Grid> &rep : replicas) {
+        rep.energy = snap.in->svarint();
+        rep.temp = snap.in->f64();
+        snap.in->rng(rep.gen);
+        rep.wires = wires;
+        snap.in->wires(rep.wires);
+        rep.occupancy = make_grid<Grid>(dim_x, dim_y);
+        snap.in->grid(rep.occupancy);
+      }
+    }
+
+    #pragma omp parallel num_threads(std::min(num_threads, num_replicas))
+    {
+      // replicas stay on the thread that copied them in, only temperatures move
+      if (!snap.in) {
+        #pragma omp for schedule(static, 1)
+        for (int r = 0; r < num_replicas; r++) {
+          replicas[r].occupancy = occupancy;
+          replicas[r].wires = wires;
+        }
+      }
+
+      for (int t = snap.start_iter; t < iters; t++) {
+        // TIME STEP LOOP
+        #pragma omp for schedule(static, 1)
+        for (int r = 0; r < num_replicas; r++)
+          anneal_sweep<Cost>(replicas[r]);
+
+        #pragma omp single
         {
-          reroute(wire, empty, occupancy); // unroute the normal wire
+          for (const replica_t<Grid> &rep: replicas) {
+            if (rep.energy < best_energy) {
+              best_energy = rep.energy;
+              best_wires = rep.wires;
+            }
+          }
+          // alternate even and odd neighbour pairs between sweeps
+          for (int s = t % 2; s + 1 < num_replicas; s += 2) {
+            replica_t<Grid> &a = replicas[ladder[s]];
+            replica_t<Grid> &b = replicas[ladder[s + 1]];
+            double log_acc = (1.0 / a.temp - 1.0 / b.temp) * (a.energy - b.energy);
+            swaps_tried++;
+            if (log_acc >= 0 || coin(swap_gen) < std::exp(log_acc)) {
+              std::swap(ladder[s], ladder[s + 1]);
+              a.temp = temps[s + 1];
+              b.temp = temps[s];
+              swaps_done++;
+            }
+          }
+          if (snap.due(t + 1, iters))
+            snap.out->save(t + 1, save_state);
         }
-        min_cost = MAX_COST;
-        best_path = wire;
-        all_wires = get_all_wires(start, end, num_threads);
-        float p = (double(std::rand()) / (RAND_MAX));
-        if (0.f <= p && p <= prob)
-          best_path = all_wires[std::uniform_int_distribution<>(
-                  0, all_wires.size()-1)(gen)];
-        else {
-          for (Wire &new_path: all_wires) {
-            int new_cost;
-            new_cost = cost_for_path(wire, new_path, occupancy);
-            if (new_cost < min_cost)
-            {
-              min_cost = new_cost;
-              best_path = new_path;
+      }
+    }
+
+    log << "Replica swap acceptance: " << swaps_done << '/' << swaps_tried << '\n';
+
+    // hand back the best layout seen by any replica
+    wires = best_wires;
+    clear_grid(occupancy);
+    for (const Wire &wire: wires)
+      reroute(empty, wire, occupancy);
+}
+
+// DOMAIN DECOMPOSITION SOLUTION
+// a rectangle [x0, x1) x [y0, y1) of the board owned by one thread, and the
+// wires whose bounding boxes lie entirely inside it
+struct region_t {
+  int x0, y0, x1, y1;
+  std::vector<int> wires;
+  bool contains(Point a, Point b) const {
+    return std::min(a.x, b.x) >= x0 && std::max(a.x, b.x) < x1 &&
+           std::min(a.y, b.y) >= y0 && std::max(a.y, b.y) < y1;
+  }
+};
+
+/* Splits r into parts regions by recursive bisection: the longer side is cut
+so that the wires centered on either side carry work in proportion to the
+parts each side gets, so regions shrink where wires are dense. ids holds the
+wires centered in r and work their estimated scan cost. */
+void bisect_regions(const region_t &r, int parts, std::vector<int> ids,
+                    const wire_set_t &wires, const std::vector<double> &work,
+                    std::vector<region_t> &out) {
+  const bool cut_x = r.x1 - r.x0 >= r.y1 - r.y0;
+  const int lo = cut_x ? r.x0 : r.y0, hi = cut_x ? r.x1 : r.y1;
+  if (parts == 1 || hi - lo < 2) {
+    out.push_back(r);
+    // a region too thin to cut leaves its remaining threads an empty region
+    for (int p = 1; p < parts; p++)
+      out.push_back({ r.x1, r.y1, r.x1, r.y1, {} });
+    return;
+  }
+
+  // twice the center, to stay in integers
+  auto center = [&](int i) {
+    const Wire &w = wires[i];
+    return cut_x ? w.pts[0].x + w.pts[w.num_pts - 1].x : w.pts[0].y + w.pts[w.num_pts - 1].y;
+  };
+  std::sort(ids.begin(), ids.end(), [&](int a, int b) { return center(a) < center(b); });
+  const int left_parts = parts / 2;
+  double total = 0;
+  for (int i : ids)
+    total += work[i];
+
+  int cut = (lo + hi) / 2;
+  double acc = 0;
+  for (int i : ids) {
+    acc += work[i];
+    if (acc * parts >= total * left_parts) {
+      cut = center(i) / 2 + 1;
+      break;
+    }
+  }
+  cut = std::clamp(cut, lo + 1, hi - 1);
+
+  region_t left = r, right = r;
+  (cut_x ? left.x1 : left.y1) = cut;
+  (cut_x ? right.x0 : right.y0) = cut;
+  std::vector<int> left_ids, right_ids;
+  for (int i : ids)
+    (center(i) / 2 < cut ? left_ids : right_ids).push_back(i);
+  bisect_regions(left, left_parts, std::move(left_ids), wires, work, out);
+  bisect_regions(right, parts - left_parts, std::move(right_ids), wires, work, out);
+}
+
+/* Partitions the board into one region per thread and routes in two phases
+per iteration. In the interior phase every thread reroutes the wires inside
+its own region with no synchronization at all: their candidate routes stay
+within the region, so no two threads ever touch the same cell. The wires
+that cross a region boundary are then routed one at a time by the whole team,
+which splits each wire's route space like solve_within_wires does. */
+template <typename Cost, typename Grid>
+void solve_domains(
+    Grid &occupancy,
+    wire_set_t &wires,
+    int dim_x, int dim_y, int num_wires,
+    int num_threads, float prob,
+    int iters, std::ostream &log = std::cout,
+    const search_budget_t &budget = search_budget_t(),
+    unsigned seed = std::random_device()(),
+    const snapshot_ctl_t &snap = snapshot_ctl_t()) {
+
+    typedef typename Cost::value_t cost_t;
+    Wire empty{};
+    log << "solving with domain decomposition\n";
+    // regions only depend on the wire endpoints, so a resumed solve cuts
+    // the same ones
+    if (snap.in) {
+      snap.in->wires(wires);
+      snap.in->grid(occupancy);
+    }
+
+    // estimate each wire's scan cost as its route count times its length
+    std::vector<int> routable;
+    std::vector<double> work(wires.size(), 0);
+    for (int i = 0; i < (int)wires.size(); i++) {
+      const Point start = wires[i].pts[0], end = wires[i].pts[wires[i].num_pts - 1];
+      if (on_same_line(start, end)) continue;
+      routable.push_back(i);
+      work[i] = double(count_routes(start, end)) *
+                (std::abs(end.x - start.x) + std::abs(end.y - start.y) + 1);
+    }
+
+    std::vector<region_t> regions;
+    bisect_regions({ 0, 0, dim_x, dim_y, {} }, num_threads, routable, wires, work, regions);
+    std::vector<int> boundary;
+    for (int i : routable) {
+      const Point start = wires[i].pts[0], end = wires[i].pts[wires[i].num_pts - 1];
+      bool inside = false;
+      for (region_t &r : regions) {
+        if (r.contains(start, end)) {
+          r.wires.push_back(i);
+          inside = true;
+          break;
+        }
+      }
+      if (!inside)
+        boundary.push_back(i);
+    }
+
+    size_t largest = 0;
+    for (const region_t &r : regions)
+      largest = std::max(largest, r.wires.size());
+    log << "Domain regions: " << regions.size() << ", interior wires: "
+        << routable.size() - boundary.size() << " (largest region " << largest
+        << "), boundary wires: " << boundary.size() << '\n';
+
+    // boundary scans are split into num_threads parts whatever team is
+    // granted, each with its own -B generator
+    std::vector<scan_slot_t<Cost>> slots(num_threads);
+    std::vector<std::mt19937> scan_gens(num_threads);
+    std::vector<double> interior_time(num_threads, 0);
+    double boundary_time = 0;
+    int team = num_threads;
+    bool random_pick = false;
+    long long pick = 0;
+    // random picks of boundary wires come from one generator whichever
+    // thread runs the single
+    std::mt19937 pick_gen(seed);
+    if (snap.in)
+      snap.in->rng(pick_gen);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+      const int tid = omp_get_thread_num();
+      // the team may be smaller than -n asked for; the regions stay as cut
+      // and are dealt round robin, so every one is still routed, and the
+      // boundary scan parts are dealt the same way
+      #pragma omp single
+      team = omp_get_num_threads();
+      std::mt19937 gen;
+      std::uniform_real_distribution<float> coin(0.f, 1.f);
+
+      for (int t = snap.start_iter; t < iters; t++) {
+        // TIME STEP LOOP
+        double t0 = omp_get_wtime();
+        for (int k = tid; k < (int)regions.size(); k += team) {
+          // seeded per region, so the interior routes the same whatever the team
+          gen = iteration_gen(seed, t, k);
+          for (int i : regions[k].wires) {
+            Wire &wire = wires[i];
+            const Point start = wire.pts[0];
+            const Point end = wire.pts[wire.num_pts - 1];
+            const long long num_routes = count_routes(start, end);
+            reroute(wire, empty, occupancy);
+            long long best_idx = 0;
+            const long long route_budget = budget.for_wire(start, end);
+            if (coin(gen) <= prob) {
+              best_idx = std::uniform_int_distribution<long long>(0, num_routes - 1)(gen);
+            } else if (num_routes > route_budget) {
+              scan_slot_t<Cost> best;
+              budgeted_scan(wire, start, end, occupancy, route_budget, gen, 0, 1, best);
+              best_idx = best.idx;
+            } else {
+              cost_t best_cost = std::numeric_limits<cost_t>::max();
+              for (long long r = 0; r < num_routes; r++) {
+                cost_t cost = cost_for_path<Cost>(wire, route_at(start, end, r), occupancy);
+                if (cost < best_cost) {
+                  best_cost = cost;
+                  best_idx = r;
+                }
+              }
             }
+            wire = route_at(start, end, best_idx);
+            reroute(empty, wire, occupancy);
+          }
+        }
+        interior_time[tid] += omp_get_wtime() - t0;
+        #pragma omp barrier
+
+        for (int p = tid; p < num_threads; p += team)
+          scan_gens[p] = iteration_gen(seed, t, regions.size() + p);
+        double t1 = omp_get_wtime();
+        for (int i : boundary) {
+          Wire &wire = wires[i];
+          const Point start = wire.pts[0];
+          const Point end = wire.pts[wire.num_pts - 1];
+          const long long num_routes = count_routes(start, end);
+          #pragma omp single
+          {
+            reroute(wire, empty, occupancy);
+            random_pick = coin(pick_gen) <= prob;
+            if (random_pick)
+              pick = std::uniform_int_distribution<long long>(0, num_routes - 1)(pick_gen);
+          }
+
+          const long long route_budget = budget.for_wire(start, end);
+          for (int p = tid; p < num_threads; p += team) {
+            scan_slot_t<Cost> &mine = slots[p];
+            mine.cost = std::numeric_limits<cost_t>::max();
+            mine.idx = 0;
+            if (!random_pick && num_routes > route_budget) {
+              budgeted_scan(wire, start, end, occupancy, route_budget, scan_gens[p], p,
+                            num_threads, mine);
+            } else if (!random_pick) {
+              const long long lo = num_routes * p / num_threads;
+              const long long hi = num_routes * (p + 1) / num_threads;
+              for (long long r = lo; r < hi; r++) {
+                cost_t cost = cost_for_path<Cost>(wire, route_at(start, end, r), occupancy);
+                if (cost < mine.cost) {
+                  mine.cost = cost;
+                  mine.idx = r;
+                }
+              }
+            }
+          }
+          #pragma omp barrier
+
+          #pragma omp single
+          {
+            long long best_idx = pick;
+            if (!random_pick) {
+              // slots are in index order, so ties keep the lowest index
+              cost_t best_cost = std::numeric_limits<cost_t>::max();
+              for (const scan_slot_t<Cost> &slot : slots) {
+                if (slot.cost < best_cost) {
+                  best_cost = slot.cost;
+                  best_idx = slot.idx;
+                }
+              }
+            }
+            wire = route_at(start, end, best_idx);
+            reroute(empty, wire, occupancy);
+          }
+        }
+        #pragma omp master
+        boundary_time += omp_get_wtime() - t1;
+        if (snap.due(t + 1, iters)) {
+          #pragma omp single
+          snap.out->save(t + 1, [&](snapshot_out_t &out) {
+            out.wires(wires);
+            out.grid(occupancy);
+            out.rng(pick_gen);
+          });
+        }
+      }
+    }
+
+    double interior = 0, interior_max = 0;
+    for (double t : interior_time) {
+      interior += t / team;
+      interior_max = std::max(interior_max, t);
+    }
+    log << "Domain interior time per thread (sec): " << interior
+        << " (slowest " << interior_max << ")\n";
+    log << "Domain boundary time (sec): " << boundary_time << '\n';
+}
+
+// MAZE ROUTING FALLBACK
+// a rectilinear path found by maze_route, kept as its turning points since
+// it is not limited to 3 bends
+struct maze_path_t {
+  int wire_idx;
+  std::vector<Point> keypoints;
+};
+
+/* Cheapest path from start to end over the cells of a window around the
+wire's bounding box, where entering a cell costs Cost::cell(occ) just like
+in cost_for_path. This is a label-correcting search driven by a bitset frontier:
+each round, every cell next to a frontier cell (found with shifts and ors on
+whole 64-bit words) pulls the best distance from its frontier neighbours.
+Rows are split across threads and each thread only writes its own rows, so
+no locking is needed. The cells of the path are returned start to end.
+
+The search keeps three cost_t arrays over the window, so the margin shrinks
+until the window fits MAZE_MAX_WINDOW_CELLS; a bounding box bigger than that
+is not searched. max_work caps the cell relaxations, the search gives up
+once a round goes over it. Either way the path comes back empty. */
+template <typename Cost, typename Grid>
+std::vector<Point> maze_route(Point start, Point end, const Grid &occupancy,
+                              int dim_x, int dim_y, int num_threads,
+                              long long max_work = std::numeric_limits<long long>::max()) {
+  const long long bw = std::abs(end.x - start.x) + 1, bh = std::abs(end.y - start.y) + 1;
+  if (bw * bh > MAZE_MAX_WINDOW_CELLS)
+    return {};
+  int margin = std::max(MAZE_MIN_MARGIN,
+      std::max(std::abs(end.x - start.x), std::abs(end.y - start.y)) / 4);
+  while (margin > 0 && (bw + 2 * margin) * (bh + 2 * margin) > MAZE_MAX_WINDOW_CELLS)
+    margin /= 2;
+  const int x0 = std::max(0, std::min(start.x, end.x) - margin);
+  const int y0 = std::max(0, std::min(start.y, end.y) - margin);
+  const int w = std::min(dim_x, std::max(start.x, end.x) + margin + 1) - x0;
+  const int h = std::min(dim_y, std::max(start.y, end.y) + margin + 1) - y0;
+  const int words = (w + 63) / 64;
+  const uint64_t tail = w % 64 ? (uint64_t(1) << (w % 64)) - 1 : ~uint64_t(0);
+  typedef typename Cost::value_t cost_t;
+  const cost_t inf = std::numeric_limits<cost_t>::max() / 2;
+
+  std::vector<cost_t> weight(size_t(w) * h), dist(size_t(w) * h, inf), next(size_t(w) * h);
+  std::vector<uint64_t> frontier(size_t(words) * h, 0), next_frontier(size_t(words) * h);
+
+  #pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (int r = 0; r < h; r++) {
+    for (int c = 0; c < w; c++) {
+      weight[size_t(r) * w + c] = Cost::cell(occupancy[y0 + r][x0 + c]);
+    }
+  }
+
+  auto at = [&](int r, int c) { return size_t(r) * w + c; };
+  const int sr = start.y - y0, sc = start.x - x0;
+  dist[at(sr, sc)] = weight[at(sr, sc)];
+  frontier[size_t(sr) * words + sc / 64] |= uint64_t(1) << (sc % 64);
+
+  bool active = true;
+  long long work = 0;
+  while (active) {
+    active = false;
+    #pragma omp parallel for schedule(static) num_threads(num_threads) reduction(||: active) reduction(+: work)
+    for (int r = 0; r < h; r++) {
+      const uint64_t *f = &frontier[size_t(r) * words];
+      const uint64_t *up = r > 0 ? f - words : nullptr;
+      const uint64_t *down = r + 1 < h ? f + words : nullptr;
+      uint64_t *nf = &next_frontier[size_t(r) * words];
+      for (int wi = 0; wi < words; wi++) {
+        uint64_t left = (f[wi] << 1) | (wi > 0 ? f[wi - 1] >> 63 : 0);
+        uint64_t right = (f[wi] >> 1) | (wi + 1 < words ? f[wi + 1] << 63 : 0);
+        uint64_t near = left | right | (up ? up[wi] : 0) | (down ? down[wi] : 0);
+        if (wi == words - 1) near &= tail;
+        work += __builtin_popcountll(near);
+        uint64_t improved = 0;
+        while (near) {
+          int b = __builtin_ctzll(near);
+          near &= near - 1;
+          int c = wi * 64 + b;
+          cost_t best = dist[at(r, c)];
+          cost_t step = weight[at(r, c)];
+          if ((left >> b) & 1) best = std::min(best, dist[at(r, c - 1)] + step);
+          if ((right >> b) & 1) best = std::min(best, dist[at(r, c + 1)] + step);
+          if (up && ((up[wi] >> b) & 1)) best = std::min(best, dist[at(r - 1, c)] + step);
+          if (down && ((down[wi] >> b) & 1)) best = std::min(best, dist[at(r + 1, c)] + step);
+          if (best < dist[at(r, c)]) {
+            next[at(r, c)] = best;
+            improved |= uint64_t(1) << b;
           }
         }
+        nf[wi] = improved;
+        active = active || improved;
+      }
+    }
+
+    // publish this round's improvements, they form the next frontier
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int r = 0; r < h; r++) {
+      for (int wi = 0; wi < words; wi++) {
+        uint64_t bits = next_frontier[size_t(r) * words + wi];
+        while (bits) {
+          int c = wi * 64 + __builtin_ctzll(bits);
+          bits &= bits - 1;
+          dist[at(r, c)] = next[at(r, c)];
+        }
+      }
+    }
+    std::swap(frontier, next_frontier);
+    if (work > max_work)
+      return {};
+  }
+
+  // walk back from the end along tight edges, preferring to keep going
+  // straight so the path has as few turns as possible
+  std::vector<Point> path;
+  int r = end.y - y0, c = end.x - x0, dr = 0, dc = 0;
+  path.push_back(end);
+  while (r != sr || c != sc) {
+    const cost_t need = dist[at(r, c)] - weight[at(r, c)];
+    const int dirs[5][2] = { { dr, dc }, { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } };
+    for (const auto &d : dirs) {
+      int nr = r + d[0], nc = c + d[1];
+      if ((d[0] == 0 && d[1] == 0) || nr < 0 || nr >= h || nc < 0 || nc >= w)
+        continue;
+      if (dist[at(nr, nc)] == need) {
+        dr = d[0];
+        dc = d[1];
+        break;
+      }
+    }
+    r += dr;
+    c += dc;
+    path.push_back({ x0 + c, y0 + r });
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
 
-        if (best_path == wire) {
-          continue;
-        } else
-        #pragma omp critical
+// largest occupancy any cell of wire n would see if it were laid down
+template <typename Grid>
+int max_occupancy_on(const Wire &n, const Grid &occupancy) {
+  int worst = 0;
+  for (const Point &p: n)
+    worst = std::max(worst, occupancy[p.y][p.x] + 1);
+  return worst;
+}
+
+/* Fallback stage for wires the <=3-bend search left in hotspots: any wire
+whose path cost averages more than threshold per cell is maze routed, then
+projected back onto the <=3-bend route sharing the most cells with the maze
+path (cheaper route on ties). The projection is kept if it lowers the worst
+occupancy along the wire, or keeps it and lowers the cost. If maze_paths is
+given the raw maze paths are collected there as well.
+
+Under -B a wire's search may relax as many cells as scoring its route budget
+would read, and the projection scores at most that many routes, evenly spaced
+over the route indices. A wire whose search runs out of budget, or whose
+window is too big to search, keeps its route. */
+template <typename Cost, typename Grid>
+void maze_fallback(
+    Grid &occupancy,
+    wire_set_t &wires,
+    int dim_x, int dim_y,
+    int num_threads, float threshold,
+    std::vector<maze_path_t> *maze_paths, std::ostream &log = std::cout,
+    const search_budget_t &budget = search_budget_t()) {
+
+    typedef typename Cost::value_t cost_t;
+    Wire empty{};
+    int hot = 0, improved = 0, skipped = 0;
+    std::vector<char> on_path;
+    for (size_t wi = 0; wi < wires.size(); wi++) {
+      Wire &wire = wires[wi];
+      Point start = wire.pts[0];
+      Point end = wire.pts[wire.num_pts - 1];
+      if (on_same_line(start, end)) continue;
+
+      reroute(wire, empty, occupancy);
+      const int length = std::abs(end.x - start.x) + std::abs(end.y - start.y) + 1;
+      const cost_t cur_cost = cost_for_path<Cost>(wire, wire, occupancy);
+      if (cur_cost <= threshold * length * Cost::unit) {
+        reroute(empty, wire, occupancy);
+        continue;
+      }
+      hot++;
+
+      const long long route_budget = budget.for_wire(start, end);
+      const long long max_work = budget.enabled() ? route_budget * length
+                                                  : std::numeric_limits<long long>::max();
+      std::vector<Point> path = maze_route<Cost>(start, end, occupancy, dim_x, dim_y,
+                                                 num_threads, max_work);
+      if (path.empty()) {
+        reroute(empty, wire, occupancy);
+        skipped++;
+        continue;
+      }
+
+      // mark the maze cells inside the wire's bounding box, which is all
+      // the <=3-bend routes can reach
+      const int bx = std::min(start.x, end.x), by = std::min(start.y, end.y);
+      const int bw = std::abs(end.x - start.x) + 1;
+      on_path.assign(size_t(bw) * (std::abs(end.y - start.y) + 1), 0);
+      for (const Point &p: path) {
+        if (p.x >= bx && p.x < bx + bw && p.y >= by && p.y - by <= std::abs(end.y - start.y))
+          on_path[size_t(p.y - by) * bw + (p.x - bx)] = 1;
+      }
+
+      const long long num_routes = count_routes(start, end);
+      const long long num_scored = std::min(num_routes, route_budget);
+      int best_overlap = -1;
+      cost_t best_cost = std::numeric_limits<cost_t>::max();
+      long long best_idx = 0;
+      std::mutex best_lock;
+      #pragma omp parallel num_threads(num_threads)
+      {
+        int my_overlap = -1;
+        cost_t my_cost = std::numeric_limits<cost_t>::max();
+        long long my_idx = 0;
+        #pragma omp for schedule(static) nowait
+        for (long long k = 0; k < num_scored; k++) {
+          const long long i = num_scored == num_routes ? k
+              : (long long)((double)k * num_routes / num_scored);
+          Wire cand = route_at(start, end, i);
+          int overlap = 0;
+          for (const Point &p: cand)
+            overlap += on_path[size_t(p.y - by) * bw + (p.x - bx)];
+          if (overlap < my_overlap) continue;
+          cost_t cost = cost_for_path<Cost>(wire, cand, occupancy);
+          if (overlap > my_overlap || cost < my_cost) {
+            my_overlap = overlap;
+            my_cost = cost;
+            my_idx = i;
+          }
+        }
         {
-          reroute(empty, best_path, occupancy);
-          wire = best_path;
+          std::lock_guard<std::mutex> guard(best_lock);
+          if (my_overlap > best_overlap ||
+              (my_overlap == best_overlap && (my_cost < best_cost ||
+                  (my_cost == best_cost && my_idx < best_idx)))) {
+            best_overlap = my_overlap;
+            best_cost = my_cost;
+            best_idx = my_idx;
+          }
+        }
+      }
+
+      Wire projected = route_at(start, end, best_idx);
+      int cur_worst = max_occupancy_on(wire, occupancy);
+      int new_worst = max_occupancy_on(projected, occupancy);
+      if (new_worst < cur_worst || (new_worst == cur_worst && best_cost < cur_cost)) {
+        wire = projected;
+        improved++;
+      }
+      reroute(empty, wire, occupancy);
+
+      if (maze_paths) {
+        maze_path_t mp;
+        mp.wire_idx = wi;
+        for (size_t i = 0; i < path.size(); i++) {
+          bool turn = i > 0 && i + 1 < path.size() &&
+              (path[i - 1].x == path[i].x) != (path[i].x == path[i + 1].x);
+          if (i == 0 || i + 1 == path.size() || turn)
+            mp.keypoints.push_back(path[i]);
         }
+        maze_paths->push_back(std::move(mp));
       }
     }
+    log << "Maze fallback: " << improved << " of " << hot
+              << " hot wires rerouted";
+    if (skipped > 0)
+      log << " (" << skipped << " over budget or window)";
+    log << '\n';
+}
+
+/* Extended output for the maze fallback: one line per maze routed wire with
+its index, the number of keypoints and the keypoints themselves. Unlike
+wire_output.txt these paths may have any number of bends. */
+void write_maze_output(
+    const std::vector<maze_path_t> &maze_paths, const int dim_x, const int dim_y,
+    std::string maze_output_file_path = "outputs/maze_output.txt") {
+
+  std::ofstream out_maze(maze_output_file_path, std::fstream::out);
+  if (!out_maze) {
+    std::cerr << "Unable to open file: " << maze_output_file_path << '\n';
+    exit(EXIT_FAILURE);
+  }
+  out_maze << dim_x << ' ' << dim_y << '\n';
+  out_maze << maze_paths.size() << '\n';
+  for (const auto &mp : maze_paths) {
+    out_maze << mp.wire_idx << ' ' << mp.keypoints.size();
+    for (const Point &p : mp.keypoints)
+      out_maze << ' ' << p.x << ' ' << p.y;
+    out_maze << '\n';
+  }
+  out_maze.close();
 }
 
-void print_stats(const matrix_t &occupancy) {
+struct occ_stats_t {
+  int max_occupancy;
+  long long total_cost;
+};
+
+template <typename Cost, typename Grid>
+occ_stats_t print_stats(const Grid &occupancy, std::ostream &log = std::cout) {
   int max_occupancy = 0;
   long long total_cost = 0;
 
-  for (const auto &row : occupancy) {
-    for (const int count : row) {
-      max_occupancy = std::max(max_occupancy, count);
-      total_cost += count * count;
-    }
-  }
+  for_each_cell(occupancy, [&](int x, int y, int count) {
+    max_occupancy = std::max(max_occupancy, count);
+    total_cost += Cost::total(count);
+  });
 
-  std::cout << "Max occupancy: " << max_occupancy << '\n';
-  std::cout << "Total cost: " << total_cost << '\n';
+  log << "Max occupancy: " << max_occupancy << '\n';
+  log << "Total cost: " << total_cost << '\n';
+  return { max_occupancy, total_cost };
 }
 
 /* This function write the output into 2 files
@@ -285,141 +1455,421 @@ void print_stats(const matrix_t &occupancy) {
 (2) It convert wires from Wire to validate_wire_t by to_validate_format
 (2) It write wires into another file
 */
-void write_output(
-    const std::vector<Wire> &wires, const int num_wires,
-    const std::vector<std::vector<int>> &occupancy, const int dim_x,
-    const int dim_y,
-    std::string wires_output_file_path = "outputs/wire_output.txt",
-    std::string occupancy_output_file_path = "outputs/occ_output.txt") {
+// appends v in decimal
+inline void append_int(std::string &out, int v) {
+  char buf[16];
+  out.append(buf, std::to_chars(buf, buf + sizeof buf, v).ptr);
+}
 
-  std::ofstream out_occupancy(occupancy_output_file_path, std::fstream::out);
-  if (!out_occupancy) {
+/* The two output files are formatted into blocks and handed to a
+block_writer_t, which writes them asynchronously where it can. */
+template <typename Grid>
+void write_occ_output(const Grid &occupancy, const int dim_x, const int dim_y,
+                      const std::string &occupancy_output_file_path) {
+  block_writer_t out_occupancy(occupancy_output_file_path);
+  if (!out_occupancy.ok()) {
     std::cerr << "Unable to open file: " << occupancy_output_file_path << '\n';
     exit(EXIT_FAILURE);
   }
-  out_occupancy << dim_x << ' ' << dim_y << '\n';
+  append_int(out_occupancy.block(), dim_x);
+  out_occupancy.block() += ' ';
+  append_int(out_occupancy.block(), dim_y);
+  out_occupancy.block() += '\n';
 
-  for (const auto &row : occupancy) {
-    for (size_t i = 0; i < row.size(); ++i)
-      out_occupancy << row[i] << (i == row.size() - 1 ? "" : " ");
-    out_occupancy << '\n';
+  // untouched tiles of a sparse grid are written from a prebuilt run of zeros
+  std::string zeros;
+  for (int i = 0; i < TILE_SIZE; ++i)
+    zeros += "0 ";
+  for (int y = 0; y < dim_y; ++y) {
+    std::string &row = out_occupancy.block();
+    int x = 0;
+    for_each_row_run(occupancy, y, [&](const int *counts, int n, bool all_zero) {
+      if (all_zero) {
+        row.append(zeros.data(), 2 * n - (x + n == dim_x));
+      } else {
+        for (int i = 0; i < n; ++i) {
+          append_int(row, counts[i]);
+          if (x + i != dim_x - 1)
+            row += ' ';
+        }
+      }
+      x += n;
+    });
+    row += '\n';
+    if (row.size() >= OUTPUT_BLOCK)
+      out_occupancy.commit();
   }
   out_occupancy.close();
+}
 
-  std::ofstream out_wires(wires_output_file_path, std::fstream::out);
-  if (!out_wires) {
+void write_wire_output(const std::vector<Wire> &wires, const int num_wires,
+                       const int dim_x, const int dim_y,
+                       const std::string &wires_output_file_path) {
+  block_writer_t out_wires(wires_output_file_path);
+  if (!out_wires.ok()) {
     std::cerr << "Unable to open file: " << wires_output_file_path << '\n';
     exit(EXIT_FAILURE);
   }
-
-  out_wires << dim_x << ' ' << dim_y << '\n';
-  out_wires << num_wires << '\n';
+  std::string *block = &out_wires.block();
+  append_int(*block, dim_x);
+  *block += ' ';
+  append_int(*block, dim_y);
+  *block += '\n';
+  append_int(*block, num_wires);
+  *block += '\n';
 
   for (const auto &wire : wires) {
     // NOTICE: we convert to keypoint representation here, using
     // to_validate_format which need to be defined in the bottom of this file
     validate_wire_t keypoints = wire.to_validate_format();
     for (int i = 0; i < keypoints.num_pts; ++i) {
-      out_wires << keypoints.p[i].x << ' ' << keypoints.p[i].y;
+      append_int(*block, keypoints.p[i].x);
+      *block += ' ';
+      append_int(*block, keypoints.p[i].y);
       if (i < keypoints.num_pts - 1)
-        out_wires << ' ';
+        *block += ' ';
+    }
+    *block += '\n';
+    if (block->size() >= OUTPUT_BLOCK) {
+      out_wires.commit();
+      block = &out_wires.block();
     }
-    out_wires << '\n';
   }
-
   out_wires.close();
 }
 
+template <typename Grid>
+void write_output(
+    const std::vector<Wire> &wires, const int num_wires,
+    const Grid &occupancy, const int dim_x,
+    const int dim_y,
+    std::string wires_output_file_path = "outputs/wire_output.txt",
+    std::string occupancy_output_file_path = "outputs/occ_output.txt") {
+  write_occ_output(occupancy, dim_x, dim_y, occupancy_output_file_path);
+  write_wire_output(wires, num_wires, dim_x, dim_y, wires_output_file_path);
+}
 
-int main(int argc, char *argv[]) {
-  const auto init_start = std::chrono::steady_clock::now();
 
-  std::string input_filename;
+// command line settings shared by every stage of a run
+struct route_opts_t {
   int num_threads = 0;
   double SA_prob = 0.1;
   int SA_iters = 5;
   char parallel_mode = '\0';
   int batch_size = 1;
+  int num_replicas = 0;
+  double max_temp = 4.0;
+  std::string heatmap_filename;
+  bool heatmap_overlay = false;   // --heatmap-overlay: draw the wires over -H
+  bool heatmap_mean = false;      // --heatmap-mean: mean instead of max pooling
+  int heatmap_size = HEATMAP_DEFAULT_SIZE;   // --heatmap-size: longest side in px
+  float maze_threshold = 0;
+  bool maze_output = false;
+  bool sparse = false;
+  std::string cost = quadratic_cost::name;   // -c, one of the costpolicy.h names
+  bool batch = false;             // -F: several boards share the process
+  std::string tune_profile = "outputs/autotune_profile.txt";
+  int tune_samples = AUTOTUNE_DEFAULT_SAMPLES;
+  search_budget_t budget;         // -B, exhaustive when not enabled
+  bool budget_gap = false;        // -G
+  bool pipeline = false;          // -a: overlap parsing and output with other work
+  bool seeded = false;            // --seed, else every board draws its own
+  unsigned seed = 0;
+  std::string checkpoint;         // --checkpoint: snapshot file, none when empty
+  int checkpoint_every = 1;       // --checkpoint-every: iterations between snapshots
+  std::string resume;             // --resume: snapshot to continue from
+  // read once by main: the --resume header, and the snapshot positioned
+  // just past it for the solver
+  snapshot_header_t resume_header;
+  std::shared_ptr<snapshot_in_t> resume_in;
+};
 
-  int opt;
-  while ((opt = getopt(argc, argv, "f:n:p:i:m:b:")) != -1) {
-    switch (opt) {
-    case 'f':
-      input_filename = optarg;
-      break;
-    case 'n':
-      num_threads = atoi(optarg);
-      break;
-    case 'p':
-      SA_prob = atof(optarg);
-      break;
-    case 'i':
-      SA_iters = atoi(optarg);
-      break;
-    case 'm':
-      parallel_mode = *optarg;
-      break;
-    case 'b':
-      batch_size = atoi(optarg);
-      break;
-    default:
-      std::cerr << "Usage: " << argv[0]
-                << " -f input_filename -n num_threads [-p SA_prob] [-i "
-                   "SA_iters] -m parallel_mode -b batch_size\n";
-      exit(EXIT_FAILURE);
-    }
+// the settings of a run that its snapshots record
+snapshot_header_t snapshot_header(const route_opts_t &run, int dim_x, int dim_y,
+                                  const wire_set_t &wires, unsigned seed) {
+  snapshot_header_t h;
+  h.mode = run.parallel_mode;
+  h.cost = run.cost;
+  h.dim_x = dim_x;
+  h.dim_y = dim_y;
+  h.num_wires = wires.size();
+  h.endpoints = endpoint_hash(wires);
+  h.num_threads = run.num_threads;
+  h.batch_size = run.batch_size;
+  h.num_replicas = run.num_replicas;
+  h.iters = run.SA_iters;
+  h.seed = seed;
+  h.prob = run.SA_prob;
+  h.max_temp = run.max_temp;
+  h.budget_routes = run.budget.routes;
+  h.budget_per_cell = run.budget.per_cell;
+  return h;
+}
+
+// --resume: the snapshot's settings replace whatever the command line said
+void apply_snapshot_header(const snapshot_header_t &h, route_opts_t &opts) {
+  opts.parallel_mode = h.mode;
+  opts.cost = h.cost;
+  opts.num_threads = h.num_threads;
+  opts.batch_size = h.batch_size;
+  opts.num_replicas = h.num_replicas;
+  opts.SA_iters = h.iters;
+  opts.seeded = true;
+  opts.seed = h.seed;
+  opts.SA_prob = h.prob;
+  opts.max_temp = h.max_temp;
+  opts.budget.routes = h.budget_routes;
+  opts.budget.per_cell = h.budget_per_cell;
+}
+
+// AUTO TUNING
+// cheap board features that key the tuning profile
+struct board_features_t {
+  int dim_x, dim_y;
+  int routable;              // wires with more than one route
+  double mean_routes;        // mean size of the <=3-bend route space
+  long long median_area;     // median bounding box area of routable wires
+
+  // features are bucketed to powers of two so similar boards share a key;
+  // the cost policy and -B change what each mode costs, so they are part of
+  // it too
+  std::string key(const route_opts_t &opts) const {
+    auto lg = [](double v) { return v < 1 ? 0 : int(std::log2(v)) + 1; };
+    std::ostringstream ss;
+    ss << "d" << lg(dim_x) << "x" << lg(dim_y) << "_w" << lg(routable)
+       << "_r" << lg(mean_routes) << "_a" << lg(median_area) << "_n" << opts.num_threads
+       << "_c" << opts.cost << "_b";
+    if (opts.budget.per_cell > 0)
+      ss << opts.budget.per_cell << "x";
+    else
+      ss << opts.budget.routes;
+    return ss.str();
   }
+};
 
-  // Check if required options are provided
-  if (empty(input_filename) || num_threads <= 0 || SA_iters <= 0 ||
-      (parallel_mode != 'A' && parallel_mode != 'W') || batch_size <= 0) {
-    std::cerr << "Usage: " << argv[0]
-              << " -f input_filename -n num_threads [-p SA_prob] [-i SA_iters] "
-                 "-m parallel_mode -b batch_size\n";
-    exit(EXIT_FAILURE);
+board_features_t board_features(const wire_set_t &wires, int dim_x, int dim_y) {
+  board_features_t f{ dim_x, dim_y, 0, 0, 0 };
+  std::vector<long long> areas;
+  double routes = 0;
+  for (const Wire &wire : wires) {
+    Point start = wire.pts[0], end = wire.pts[wire.num_pts - 1];
+    if (on_same_line(start, end)) continue;
+    routes += count_routes(start, end);
+    areas.push_back((long long)(std::abs(end.x - start.x) + 1) * (std::abs(end.y - start.y) + 1));
   }
+  f.routable = areas.size();
+  if (!areas.empty()) {
+    f.mean_routes = routes / areas.size();
+    std::nth_element(areas.begin(), areas.begin() + areas.size() / 2, areas.end());
+    f.median_area = areas[areas.size() / 2];
+  }
+  return f;
+}
 
-  std::cout << "Number of threads: " << num_threads << '\n';
-  std::cout << "Simulated annealing probability parameter: " << SA_prob << '\n';
-  std::cout << "Simulated annealing iterations: " << SA_iters << '\n';
-  std::cout << "Input file: " << input_filename << '\n';
-  std::cout << "Parallel mode: " << parallel_mode << '\n';
-  std::cout << "Batch size: " << batch_size << '\n';
+// a mode, team size and chunking the tuner can hand to the solvers
+struct tune_choice_t {
+  char mode;
+  int num_threads;
+  int batch_size;
+};
 
-  std::ifstream fin(input_filename);
-//  omp_set_num_threads(num_threads);
-  if (!fin) {
-    std::cerr << "Unable to open file: " << input_filename << ".\n";
-    exit(EXIT_FAILURE);
+// first guess from the features alone: within-wire when the route spaces are
+// big enough to keep the team busy, across-wire batches otherwise
+tune_choice_t tune_heuristic(const board_features_t &f, int max_threads) {
+  if (f.mean_routes >= AUTOTUNE_MIN_ROUTES_PER_THREAD * max_threads)
+    return { 'W', max_threads, 1 };
+  int team = std::max(1, std::min<int>(max_threads, f.mean_routes / AUTOTUNE_MIN_ROUTES_PER_THREAD));
+  if (f.routable >= AUTOTUNE_MIN_WIRES_PER_THREAD * max_threads)
+    return { 'A', max_threads, std::clamp(f.routable / (16 * max_threads), 1, 64) };
+  return { 'W', team, 1 };
+}
+
+/* Times one iteration of every candidate choice on the same evenly spaced
+sample of wires, each on a private copy of the grid, and returns the fastest.
+Solver chatter is muted while calibrating. */
+template <typename Cost, typename Grid>
+tune_choice_t tune_calibrate(const Grid &occupancy, const wire_set_t &wires,
+                             int dim_x, int dim_y, int max_threads,
+                             float prob, int samples,
+                             const tune_choice_t &guess,
+                             const search_budget_t &budget) {
+  wire_set_t sample;
+  std::vector<int> routable;
+  for (int i = 0; i < (int)wires.size(); i++) {
+    if (!on_same_line(wires[i].pts[0], wires[i].pts[wires[i].num_pts - 1]))
+      routable.push_back(i);
   }
+  // never spend more than an eighth of an iteration per candidate
+  samples = std::min<int>(samples, std::max<int>(AUTOTUNE_MIN_SAMPLES, routable.size() / 8));
+  const int stride = std::max<int>(1, routable.size() / samples);
+  for (size_t i = 0; i < routable.size() && (int)sample.size() < samples; i += stride)
+    sample.push_back(wires[routable[i]]);
 
-  int dim_x, dim_y;
-  int num_wires;
+  std::vector<tune_choice_t> candidates = { guess, { 'W', max_threads, 1 } };
+  for (int batch : { 1, 4, 16 })
+    candidates.push_back({ 'A', max_threads, batch });
+  if (max_threads > 1)
+    candidates.push_back({ 'W', std::max(1, max_threads / 2), 1 });
 
-  /* Read the grid dimension and wire information from file */
-  fin >> dim_x >> dim_y >> num_wires;
+  std::ostream muted(nullptr);
+  tune_choice_t best = guess;
+  double best_time = std::numeric_limits<double>::max();
+  for (const tune_choice_t &c : candidates) {
+    Grid occ = occupancy;
+    wire_set_t ws = sample;
+    double t0 = omp_get_wtime();
+    if (c.mode == 'W')
+      solve_within_wires<Cost>(occ, ws, dim_x, dim_y, ws.size(), c.num_threads, prob, 1, muted, budget);
+    else
+      solve_across_wires<Cost>(occ, ws, dim_x, dim_y, ws.size(), c.num_threads, prob, 1, c.batch_size, muted, budget);
+    double elapsed = omp_get_wtime() - t0;
+    if (elapsed < best_time) {
+      best_time = elapsed;
+      best = c;
+    }
+  }
+  return best;
+}
 
-  std::vector<Wire> wires(num_wires);
-  std::vector occupancy(dim_y, std::vector<int>(dim_x, 0)); // give each value 418 which is high
-  std::cout << "Question Spec: dim_x=" << dim_x << ", dim_y=" << dim_y
-            << ", number of wires=" << num_wires << '\n';
+// the profile is a text file of "key mode num_threads batch_size" lines
+bool load_tune_profile(const std::string &path, const std::string &key, tune_choice_t &choice) {
+  std::ifstream fin(path);
+  std::string k;
+  tune_choice_t c;
+  while (fin >> k >> c.mode >> c.num_threads >> c.batch_size) {
+    if (k == key) {
+      choice = c;
+      return true;
+    }
+  }
+  return false;
+}
 
-  // TODO (student code start): Read the wire information from file,
-  // you may need to change this if you define the wire structure differently.
+void save_tune_profile(const std::string &path, const std::string &key, const tune_choice_t &choice) {
+  // boards of a -F batch may finish tuning at the same time
+  #pragma omp critical(tune_profile)
+  {
+    std::ofstream out(path, std::fstream::app);
+    if (!out)
+      std::cerr << "Unable to open file: " << path << '\n';
+    else
+      out << key << ' ' << choice.mode << ' ' << choice.num_threads << ' '
+          << choice.batch_size << '\n';
+  }
+}
+
+/* Resolves -m auto: look the board's feature key up in the profile, else
+start from the heuristic guess, calibrate when samples > 0, and remember the
+answer. -n is the largest team the tuner may pick. */
+template <typename Cost, typename Grid>
+void autotune(const Grid &occupancy, const wire_set_t &wires, int dim_x, int dim_y,
+              route_opts_t &opts, std::ostream &log = std::cout) {
+  const board_features_t f = board_features(wires, dim_x, dim_y);
+  const std::string key = f.key(opts);
+  tune_choice_t choice;
+  const char *source = "profile";
+  if (!load_tune_profile(opts.tune_profile, key, choice)) {
+    choice = tune_heuristic(f, opts.num_threads);
+    source = "heuristic";
+    if (opts.tune_samples > 0 && f.routable > 0) {
+      choice = tune_calibrate<Cost>(occupancy, wires, dim_x, dim_y, opts.num_threads,
+                              opts.SA_prob, opts.tune_samples, choice, opts.budget);
+      source = "calibration";
+    }
+    save_tune_profile(opts.tune_profile, key, choice);
+  }
+  opts.parallel_mode = choice.mode;
+  opts.num_threads = choice.num_threads;
+  opts.batch_size = choice.batch_size;
+  log << "Auto-tune (" << source << ", " << key << "): mode "
+            << choice.mode << ", threads " << choice.num_threads
+            << ", batch size " << choice.batch_size << '\n';
+}
+
+// reads the endpoints of one wire from fin and sets it to its initial
+// 1-bend route
+void parse_wire(std::istream &fin, Wire &wire) {
+  fin >> wire.pts[0].x >> wire.pts[0].y >> wire.pts[2].x >> wire.pts[2].y;
+  wire.num_pts = 3;
+  if (wire.pts[0].x == wire.pts[2].x || wire.pts[0].y == wire.pts[2].y) {
+    wire.pts[1] = wire.pts[2];
+    wire.num_pts = 2;
+  } else {
+    wire.pts[1].x = wire.pts[0].x;
+    wire.pts[1].y = wire.pts[2].y;
+  }
+}
+
+// reads every wire in wires from fin and lays each one down
+template <typename Grid>
+void read_wires(std::istream &fin, wire_set_t &wires, Grid &occupancy) {
   Wire empty{};
   empty.num_pts = 0;
   for (auto &wire: wires) {
-    fin >> wire.pts[0].x >> wire.pts[0].y >> wire.pts[2].x >> wire.pts[2].y;
-    wire.num_pts = 3;
-    if (wire.pts[0].x == wire.pts[2].x || wire.pts[0].y == wire.pts[2].y) {
-      wire.pts[1] = wire.pts[2];
-      wire.num_pts = 2;
-    } else {
-      wire.pts[1].x = wire.pts[0].x;
-      wire.pts[1].y = wire.pts[2].y;
-    }
+    parse_wire(fin, wire);
     reroute(empty, wire, occupancy);
   }
+}
+
+/* read_wires for -a: a parser thread fills in wires and publishes how many
+are ready every PIPELINE_CHUNK wires, while the calling thread lays down
+whatever has been published, so building the occupancy grid overlaps with
+parsing instead of following it. */
+template <typename Grid>
+void read_wires_pipelined(std::istream &fin, wire_set_t &wires, Grid &occupancy) {
+  std::atomic<size_t> parsed{0};
+  std::thread parser([&]() {
+    for (size_t i = 0; i < wires.size(); i++) {
+      parse_wire(fin, wires[i]);
+      if ((i + 1) % PIPELINE_CHUNK == 0 || i + 1 == wires.size())
+        parsed.store(i + 1, std::memory_order_release);
+    }
+  });
+
+  Wire empty{};
+  empty.num_pts = 0;
+  for (size_t laid = 0; laid < wires.size();) {
+    const size_t ready = parsed.load(std::memory_order_acquire);
+    if (ready == laid) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (; laid < ready; laid++)
+      reroute(empty, wires[laid], occupancy);
+  }
+  parser.join();
+}
+
+// one board of a run: where it is read from, where its outputs go and the
+// numbers that end up in the -F summary table
+struct board_result_t {
+  std::string input;
+  std::string out_prefix = "outputs/";   // prepended to wire_output.txt etc.
+  std::string heatmap_filename;
+  int dim_x = 0, dim_y = 0, num_wires = 0;
+  int num_threads = 0;
+  char parallel_mode = '\0';
+  double init_time = 0, compute_time = 0;
+  occ_stats_t stats = { 0, 0 };
+  int mismatches = 0;
+};
+
+/* Builds the occupancy grid for one backend, routes, checks and writes the
+outputs. fin is left just past the wire count by route_file. */
+template <typename Cost, typename Grid>
+void route_board(std::ifstream &fin, board_result_t &board, const route_opts_t &opts,
+                 const std::chrono::steady_clock::time_point init_start,
+                 std::ostream &log) {
+  const int dim_x = board.dim_x, dim_y = board.dim_y, num_wires = board.num_wires;
+  std::vector<Wire> wires(num_wires);
+  Grid occupancy = make_grid<Grid>(dim_x, dim_y);
+
+  // TODO (student code start): Read the wire information from file,
+  // you may need to change this if you define the wire structure differently.
+  if (opts.pipeline)
+    read_wires_pipelined(fin, wires, occupancy);
+  else
+    read_wires(fin, wires, occupancy);
 
   /* Initialize any additional data structures needed in the algorithm */
 
@@ -428,8 +1878,8 @@ int main(int argc, char *argv[]) {
       std::chrono::duration_cast<std::chrono::duration<double>>(
           std::chrono::steady_clock::now() - init_start)
           .count();
-  std::cout << "Initialization time (sec): " << std::fixed
-            << std::setprecision(10) << init_time << '\n';
+  log << "Initialization time (sec): " << std::fixed
+      << std::setprecision(10) << init_time << '\n';
 
   const auto compute_start = std::chrono::steady_clock::now();
 
@@ -439,33 +1889,529 @@ int main(int argc, char *argv[]) {
     Use OpenMP to parallelize the algorithm.
   */
 
+  route_opts_t run = opts;
+  if (run.parallel_mode == 'a')
+    autotune<Cost>(occupancy, wires, dim_x, dim_y, run, log);
+  if (run.num_replicas == 0)
+    run.num_replicas = run.num_threads;
+
+  const int num_threads = run.num_threads;
+  const unsigned seed = run.seeded ? run.seed : std::random_device()();
+  log << "Random seed: " << seed << '\n';
+
+  // the snapshot body is read by the solver, main already took its settings
+  snapshot_ctl_t snap;
+  snapshot_in_t *resume = opts.resume_in.get();
+  if (resume) {
+    const snapshot_header_t &h = opts.resume_header;
+    if (h.dim_x != dim_x || h.dim_y != dim_y || h.num_wires != num_wires ||
+        h.endpoints != endpoint_hash(wires)) {
+      std::cerr << "Snapshot " << opts.resume << " does not match " << board.input << ".\n";
+      exit(EXIT_FAILURE);
+    }
+    snap.in = resume;
+    snap.start_iter = h.next_iter;
+    log << "Resuming at iteration " << h.next_iter << " of " << h.iters << '\n';
+  }
+  std::unique_ptr<checkpointer_t> checkpointer;
+  if (!opts.checkpoint.empty()) {
+    checkpointer = std::make_unique<checkpointer_t>(
+        opts.checkpoint, opts.checkpoint_every,
+        snapshot_header(run, dim_x, dim_y, wires, seed));
+    snap.out = checkpointer.get();
+  }
+  if ((snap.in || snap.out) && run.parallel_mode == 'A' && num_threads > 1)
+    log << "Mode A with more than one thread is not reproducible, a resumed "
+           "run starts from the snapshot but will not match an uninterrupted one\n";
+
 //  solve_sequential(occupancy, wires, dim_x, dim_y, num_wires);
   // initialize wires
   // Within wires
-  if (parallel_mode == 'W') {
-    solve_within_wires(occupancy, wires, dim_x, dim_y, num_wires, num_threads, SA_prob, SA_iters);
+  if (run.parallel_mode == 'W') {
+    solve_within_wires<Cost>(occupancy, wires, dim_x, dim_y, num_wires, num_threads, run.SA_prob, run.SA_iters, log, run.budget, seed, snap);
     // within wires
+  } else if (run.parallel_mode == 'D') {
+    // one spatial region per thread, boundary wires routed by the team
+    solve_domains<Cost>(occupancy, wires, dim_x, dim_y, num_wires, num_threads, run.SA_prob, run.SA_iters, log, run.budget, seed, snap);
+  } else if (run.parallel_mode == 'T') {
+    // one annealing replica per thread, periodically swapping temperatures
+    solve_tempering<Cost>(occupancy, wires, dim_x, dim_y, num_wires, num_threads, run.SA_iters, run.num_replicas, run.max_temp, log, seed, snap);
   } else {
     // across wires
-    solve_across_wires(occupancy, wires, dim_x, dim_y, num_wires, num_threads, SA_prob, SA_iters, batch_size);
+    solve_across_wires<Cost>(occupancy, wires, dim_x, dim_y, num_wires, num_threads, run.SA_prob, run.SA_iters, run.batch_size, log, run.budget, seed, snap);
+  }
+  if (resume && !resume->ok()) {
+    std::cerr << "Snapshot " << opts.resume << " is corrupt.\n";
+    exit(EXIT_FAILURE);
   }
 
+  // maze route whatever is still stuck in a hotspot
+  std::vector<maze_path_t> maze_paths;
+  if (opts.maze_threshold > 0)
+    maze_fallback<Cost>(occupancy, wires, dim_x, dim_y, num_threads, opts.maze_threshold,
+                  opts.maze_output ? &maze_paths : nullptr, log, run.budget);
+  // the last snapshot is written while the maze fallback runs
+  if (checkpointer)
+    checkpointer->finish();
+
   // Student code end
   // DON'T CHANGE THE FOLLOWING CODE
   const double compute_time =
       std::chrono::duration_cast<std::chrono::duration<double>>(
           std::chrono::steady_clock::now() - compute_start)
           .count();
-  std::cout << "Computation time (sec): " << compute_time << '\n';
+  log << "Computation time (sec): " << compute_time << '\n';
+  if (checkpointer) {
+    // what the solver spent on snapshots, which sizes --checkpoint-every
+    log << "Checkpoint stall time (sec): "
+        << checkpointer->encode_time + checkpointer->wait_time << " (encode "
+        << checkpointer->encode_time << ", waiting on writes "
+        << checkpointer->wait_time << ")\n";
+    log << "Checkpoint write time (sec): " << checkpointer->write_time << " in background, "
+        << checkpointer->count << " snapshots, "
+        << (checkpointer->count ? checkpointer->bytes / checkpointer->count : 0)
+        << " bytes each\n";
+  }
+  if (opts.budget_gap)
+    budget_gap_report<Cost>(occupancy, wires, num_threads, run.budget, log);
 
   /* wire to run check on wires and occupancy */
+  const auto finalize_start = std::chrono::steady_clock::now();
   wr_checker checker(wires, occupancy);
-  checker.validate();
+  std::ostringstream stats_log;
+  stats_log.copyfmt(log);
+  if (opts.pipeline) {
+    // the checker, the stats and each output file get a thread of their
+    // own; their log lines come out in the usual order once all are done
+    std::thread check([&]() { board.mismatches = checker.validate(true); });
+    std::thread stats([&]() { board.stats = print_stats<Cost>(occupancy, stats_log); });
+    std::thread occ_out([&]() {
+      write_occ_output(occupancy, dim_x, dim_y, board.out_prefix + "occ_output.txt");
+    });
+    write_wire_output(wires, num_wires, dim_x, dim_y, board.out_prefix + "wire_output.txt");
+    check.join();
+    stats.join();
+    occ_out.join();
+  } else {
+    board.mismatches = checker.validate(opts.batch);
+  }
+  if (opts.batch || opts.pipeline) {
+    if (board.mismatches > 0)
+      log << "Validate: " << board.mismatches << " total mismatches.\n";
+    else
+      log << "Validate Passed: no mismatches.\n";
+  }
 
   /* Write wires and occupancy matrix to files */
-  print_stats(occupancy);
-  write_output(wires, num_wires, occupancy, dim_x, dim_y);
+  if (!opts.pipeline)
+    board.stats = print_stats<Cost>(occupancy, stats_log);
+  log << stats_log.str();
+  if constexpr (std::is_same_v<Grid, tiled_grid_t>) {
+    log << "Occupancy tiles allocated: " << occupancy.allocated_tiles()
+        << '/' << occupancy.num_tiles() << " ("
+        << occupancy.allocated_tiles() * TILE_CELLS * sizeof(int) / (1 << 20)
+        << " MiB)\n";
+  }
+  if (!opts.pipeline)
+    write_output(wires, num_wires, occupancy, dim_x, dim_y,
+                 board.out_prefix + "wire_output.txt", board.out_prefix + "occ_output.txt");
+  log << "Finalize time (sec): "
+      << std::chrono::duration_cast<std::chrono::duration<double>>(
+             std::chrono::steady_clock::now() - finalize_start).count()
+      << '\n';
+  if (opts.maze_output)
+    write_maze_output(maze_paths, dim_x, dim_y, board.out_prefix + "maze_output.txt");
+
+  if (!board.heatmap_filename.empty()) {
+    heatmap_opts hm_opts;
+    hm_opts.max_size = opts.heatmap_size;
+    hm_opts.mean_pool = opts.heatmap_mean;
+    hm_opts.num_threads = run.num_threads;
+    if (opts.heatmap_overlay)
+      hm_opts.overlay = &wires;
+    render_heatmap(occupancy, hm_opts, board.heatmap_filename, log);
+  }
+
+  board.num_threads = run.num_threads;
+  board.parallel_mode = run.parallel_mode;
+  board.init_time = init_time;
+  board.compute_time = compute_time;
+}
+
+template <typename Cost>
+void route_board_with(std::ifstream &fin, board_result_t &board, const route_opts_t &opts,
+                      const std::chrono::steady_clock::time_point init_start,
+                      std::ostream &log) {
+  if (opts.sparse)
+    route_board<Cost, tiled_grid_t>(fin, board, opts, init_start, log);
+  else
+    route_board<Cost, matrix_t>(fin, board, opts, init_start, log);
+}
+
+// opens board.input, reads its header and routes it with the chosen cost
+// policy and backend
+void route_file(board_result_t &board, const route_opts_t &opts,
+                const std::chrono::steady_clock::time_point init_start,
+                std::ostream &log) {
+  std::ifstream fin(board.input);
+//  omp_set_num_threads(num_threads);
+  if (!fin) {
+    std::cerr << "Unable to open file: " << board.input << ".\n";
+    exit(EXIT_FAILURE);
+  }
+
+  /* Read the grid dimension and wire information from file */
+  fin >> board.dim_x >> board.dim_y >> board.num_wires;
+
+  log << "Question Spec: dim_x=" << board.dim_x << ", dim_y=" << board.dim_y
+      << ", number of wires=" << board.num_wires << '\n';
+
+  // pick the cost policy and occupancy backend once, everything below is
+  // specialized for the pair
+  const bool known = cost_policies::dispatch(opts.cost, [&](auto cost) {
+    route_board_with<decltype(cost)>(fin, board, opts, init_start, log);
+  });
+  if (!known) {
+    std::cerr << "Unknown cost policy: " << opts.cost << '\n';
+    exit(EXIT_FAILURE);
+  }
+}
+
+// outputs/foo.png for board dir/bar.txt becomes outputs/bar_foo.png
+std::string board_path(const std::string &path, const std::string &stem) {
+  size_t slash = path.find_last_of('/');
+  size_t cut = slash == std::string::npos ? 0 : slash + 1;
+  return path.substr(0, cut) + stem + "_" + path.substr(cut);
+}
+
+/* Routes every board listed in list_filename in one process. Boards are
+sized up front by wires x (dim_x + dim_y). A board worth at least one
+thread's share of the total is large: large boards run one after another on
+the whole pool, biggest first. The small boards then run concurrently,
+biggest first, each on an equal sub-team of the pool. Each board writes
+outputs/<stem>_wire_output.txt and friends, its log is printed in one piece
+when it finishes, and a summary table closes the run. */
+void route_batch(const std::string &list_filename, const route_opts_t &opts) {
+  std::ifstream list(list_filename);
+  if (!list) {
+    std::cerr << "Unable to open file: " << list_filename << ".\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<board_result_t> boards;
+  std::vector<double> work;
+  std::string line;
+  while (std::getline(list, line)) {
+    line.erase(0, line.find_first_not_of(" \t"));
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    if (line.empty() || line[0] == '#') continue;
+
+    board_result_t board;
+    board.input = line;
+    std::ifstream fin(line);
+    if (!fin || !(fin >> board.dim_x >> board.dim_y >> board.num_wires)) {
+      std::cerr << "Unable to open file: " << line << ".\n";
+      exit(EXIT_FAILURE);
+    }
+    size_t slash = line.find_last_of('/');
+    std::string stem = line.substr(slash == std::string::npos ? 0 : slash + 1);
+    stem = stem.substr(0, stem.find_last_of('.'));
+    for (const board_result_t &other : boards) {
+      if (other.out_prefix == "outputs/" + stem + "_")
+        stem += "_" + std::to_string(boards.size());
+    }
+    board.out_prefix = "outputs/" + stem + "_";
+    if (!opts.heatmap_filename.empty())
+      board.heatmap_filename = board_path(opts.heatmap_filename, stem);
+    work.push_back((double)board.num_wires * (board.dim_x + board.dim_y));
+    boards.push_back(board);
+  }
+
+  std::vector<int> order(boards.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return work[a] > work[b]; });
+
+  double total_work = 0;
+  for (double w : work)
+    total_work += w;
+  const int pool = opts.num_threads;
+  std::vector<int> large, small;
+  for (int i : order)
+    (work[i] * pool >= total_work ? large : small).push_back(i);
+
+  const auto batch_start = std::chrono::steady_clock::now();
+  auto run_one = [&](int i, int team) {
+    const auto init_start = std::chrono::steady_clock::now();
+    route_opts_t board_opts = opts;
+    board_opts.num_threads = team;
+    std::ostringstream log;
+    log << std::fixed << std::setprecision(10);
+    route_file(boards[i], board_opts, init_start, log);
+    #pragma omp critical(batch_log)
+    std::cout << "=== " << boards[i].input << " (" << team << " threads) ===\n"
+              << log.str();
+  };
+
+  for (int i : large)
+    run_one(i, pool);
+
+  if (!small.empty()) {
+    const int outer = std::min<int>(pool, small.size());
+    const int inner = std::max(1, pool / outer);
+    omp_set_max_active_levels(2);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(outer)
+    for (size_t k = 0; k < small.size(); k++)
+      run_one(small[k], inner);
+    omp_set_max_active_levels(1);
+  }
+
+  const double batch_time =
+      std::chrono::duration_cast<std::chrono::duration<double>>(
+          std::chrono::steady_clock::now() - batch_start)
+          .count();
+
+  std::cout << "\nBatch summary (" << boards.size() << " boards, " << pool
+            << " threads, " << std::fixed << std::setprecision(3) << batch_time
+            << " sec)\n";
+  std::cout << std::left << std::setw(40) << "board" << std::right
+            << std::setw(12) << "grid" << std::setw(8) << "wires"
+            << std::setw(6) << "mode" << std::setw(8) << "threads"
+            << std::setw(12) << "init(s)" << std::setw(12) << "compute(s)"
+            << std::setw(8) << "maxocc" << std::setw(14) << "cost"
+            << std::setw(8) << "check" << '\n';
+  for (const board_result_t &b : boards) {
+    std::cout << std::left << std::setw(40) << b.input << std::right
+              << std::setw(12) << (std::to_string(b.dim_x) + "x" + std::to_string(b.dim_y))
+              << std::setw(8) << b.num_wires << std::setw(6) << b.parallel_mode
+              << std::setw(8) << b.num_threads << std::setw(12) << b.init_time
+              << std::setw(12) << b.compute_time << std::setw(8) << b.stats.max_occupancy
+              << std::setw(14) << b.stats.total_cost
+              << std::setw(8) << (b.mismatches ? "FAIL" : "ok") << '\n';
+  }
+}
+
+// microbench.cpp includes this file for the kernels and brings its own main
+#ifndef WIREROUTE_NO_MAIN
+int main(int argc, char *argv[]) {
+  const auto init_start = std::chrono::steady_clock::now();
+
+  std::string input_filename;
+  std::string list_filename;
+  route_opts_t opts;
+  bool bad_opt = false;   // an option value that does not parse
+
+  // long options that have no short form get codes past any character
+  enum { OPT_SEED = 256, OPT_CHECKPOINT, OPT_CHECKPOINT_EVERY, OPT_RESUME,
+         OPT_HEATMAP_OVERLAY, OPT_HEATMAP_MEAN, OPT_HEATMAP_SIZE };
+  const option long_opts[] = {
+    { "seed", required_argument, nullptr, OPT_SEED },
+    { "checkpoint", required_argument, nullptr, OPT_CHECKPOINT },
+    { "checkpoint-every", required_argument, nullptr, OPT_CHECKPOINT_EVERY },
+    { "resume", required_argument, nullptr, OPT_RESUME },
+    { "heatmap-overlay", no_argument, nullptr, OPT_HEATMAP_OVERLAY },
+    { "heatmap-mean", no_argument, nullptr, OPT_HEATMAP_MEAN },
+    { "heatmap-size", required_argument, nullptr, OPT_HEATMAP_SIZE },
+    { nullptr, 0, nullptr, 0 },
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "f:F:n:p:i:m:b:r:t:H:M:Xg:P:S:c:B:Ga",
+                            long_opts, nullptr)) != -1) {
+    switch (opt) {
+    case 'f':
+      input_filename = optarg;
+      break;
+    case 'F':
+      list_filename = optarg;
+      opts.batch = true;
+      break;
+    case 'n':
+      opts.num_threads = atoi(optarg);
+      break;
+    case 'p':
+      opts.SA_prob = atof(optarg);
+      break;
+    case 'i':
+      opts.SA_iters = atoi(optarg);
+      break;
+    case 'm':
+      // 'a' stands for -m auto, resolved per board by the tuner
+      opts.parallel_mode = std::string(optarg) == "auto" ? 'a' : *optarg;
+      break;
+    case 'b':
+      opts.batch_size = atoi(optarg);
+      break;
+    case 'r':
+      opts.num_replicas = atoi(optarg);
+      break;
+    case 't':
+      opts.max_temp = atof(optarg);
+      break;
+    case 'H':
+      opts.heatmap_filename = optarg;
+      break;
+    case 'M':
+      opts.maze_threshold = atof(optarg);
+      break;
+    case 'X':
+      opts.maze_output = true;
+      break;
+    case 'P':
+      opts.tune_profile = optarg;
+      break;
+    case 'S':
+      opts.tune_samples = atoi(optarg);
+      break;
+    case 'g':
+      if (std::string(optarg) == "sparse")
+        opts.sparse = true;
+      else if (std::string(optarg) != "dense")
+        bad_opt = true;
+      break;
+    case 'c':
+      opts.cost = optarg;
+      if (!cost_policies::has(opts.cost))
+        bad_opt = true;
+      break;
+    case 'B': {
+      // a route count, or routes per cell of wire length with an x suffix
+      char *suffix;
+      double b = strtod(optarg, &suffix);
+      if (*suffix == 'x')
+        opts.budget.per_cell = b;
+      else
+        opts.budget.routes = (long long)b;
+      if (b <= 0 || (*suffix && std::string(suffix) != "x"))
+        bad_opt = true;
+      break;
+    }
+    case 'G':
+      opts.budget_gap = true;
+      break;
+    case 'a':
+      opts.pipeline = true;
+      break;
+    case OPT_SEED:
+      opts.seeded = true;
+      opts.seed = strtoul(optarg, nullptr, 10);
+      break;
+    case OPT_CHECKPOINT:
+      opts.checkpoint = optarg;
+      break;
+    case OPT_CHECKPOINT_EVERY:
+      opts.checkpoint_every = atoi(optarg);
+      break;
+    case OPT_RESUME:
+      opts.resume = optarg;
+      break;
+    case OPT_HEATMAP_OVERLAY:
+      opts.heatmap_overlay = true;
+      break;
+    case OPT_HEATMAP_MEAN:
+      opts.heatmap_mean = true;
+      break;
+    case OPT_HEATMAP_SIZE:
+      opts.heatmap_size = atoi(optarg);
+      break;
+    default:
+      std::cerr << "Usage: " << argv[0]
+                << " -f input_filename|-F boards_list -n num_threads [-p SA_prob] [-i "
+                   "SA_iters] -m parallel_mode -b batch_size [-r replicas] "
+                   "[-t max_temp] [-H heatmap_file] [-M maze_threshold] [-X] "
+                   "[-g dense|sparse] [-P tune_profile] [-S tune_samples] [-c "
+                << cost_policies::names() << "] [-B budget[x]] [-G] [-a] "
+                   "[--seed seed] [--checkpoint file] [--checkpoint-every iters] "
+                   "[--resume file] [--heatmap-overlay] [--heatmap-mean] "
+                   "[--heatmap-size px]\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // a resumed run takes its settings from the snapshot
+  if (!opts.resume.empty()) {
+    opts.resume_in = std::make_shared<snapshot_in_t>(read_snapshot(opts.resume));
+    opts.resume_header = opts.resume_in->header();
+    if (!opts.resume_in->ok()) {
+      std::cerr << "Unable to read snapshot: " << opts.resume << ".\n";
+      exit(EXIT_FAILURE);
+    }
+    apply_snapshot_header(opts.resume_header, opts);
+  }
+
+  // Check if required options are provided
+  if (bad_opt || empty(input_filename) == empty(list_filename) || opts.num_threads <= 0 ||
+      opts.SA_iters <= 0 ||
+      (opts.parallel_mode != 'A' && opts.parallel_mode != 'W' &&
+       opts.parallel_mode != 'T' && opts.parallel_mode != 'D' &&
+       opts.parallel_mode != 'a') ||
+      opts.tune_samples < 0 ||
+      opts.batch_size <= 0 || opts.num_replicas < 0 || opts.max_temp < MIN_TEMP ||
+      // a replica sweeps on one thread, fewer replicas than threads would
+      // leave threads idle
+      (opts.parallel_mode == 'T' && opts.num_replicas > 0 &&
+       opts.num_replicas < opts.num_threads) ||
+      opts.maze_threshold < 0 || (opts.maze_output && opts.maze_threshold == 0) ||
+      ((opts.heatmap_overlay || opts.heatmap_mean) && opts.heatmap_filename.empty()) ||
+      opts.heatmap_size <= 0 ||
+      (opts.budget_gap && !opts.budget.enabled()) || opts.checkpoint_every <= 0 ||
+      (opts.batch && (!opts.checkpoint.empty() || !opts.resume.empty()))) {
+    std::cerr << "Usage: " << argv[0]
+              << " -f input_filename|-F boards_list -n num_threads [-p SA_prob] [-i SA_iters] "
+                 "-m parallel_mode -b batch_size [-r replicas] [-t max_temp] "
+                 "[-H heatmap_file] [-M maze_threshold] [-X] [-g dense|sparse] "
+                 "[-P tune_profile] [-S tune_samples] [-c "
+              << cost_policies::names() << "] [-B budget[x]] [-G] [-a] "
+                 "[--seed seed] [--checkpoint file] [--checkpoint-every iters] "
+                 "[--resume file] [--heatmap-overlay] [--heatmap-mean] "
+                 "[--heatmap-size px]\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::cout << "Number of threads: " << opts.num_threads << '\n';
+  std::cout << "Simulated annealing probability parameter: " << opts.SA_prob << '\n';
+  std::cout << "Simulated annealing iterations: " << opts.SA_iters << '\n';
+  if (opts.batch)
+    std::cout << "Board list: " << list_filename << '\n';
+  else
+    std::cout << "Input file: " << input_filename << '\n';
+  if (opts.parallel_mode == 'a')
+    std::cout << "Parallel mode: auto\n";
+  else
+    std::cout << "Parallel mode: " << opts.parallel_mode << '\n';
+  std::cout << "Batch size: " << opts.batch_size << '\n';
+  if (opts.parallel_mode == 'T') {
+    std::cout << "Replicas: "
+              << (opts.num_replicas ? opts.num_replicas : opts.num_threads) << '\n';
+    std::cout << "Max temperature: " << opts.max_temp << '\n';
+  }
+  if (opts.maze_threshold > 0)
+    std::cout << "Maze fallback threshold: " << opts.maze_threshold << '\n';
+  std::cout << "Occupancy grid: " << (opts.sparse ? "sparse" : "dense") << '\n';
+  std::cout << "Cost policy: " << opts.cost << '\n';
+  if (opts.pipeline)
+    std::cout << "Pipelined I/O: on\n";
+  if (opts.budget.per_cell > 0)
+    std::cout << "Route budget per wire: " << opts.budget.per_cell << "x length\n";
+  else if (opts.budget.routes > 0)
+    std::cout << "Route budget per wire: " << opts.budget.routes << '\n';
+  if (!opts.resume.empty())
+    std::cout << "Resuming from: " << opts.resume << '\n';
+  if (!opts.checkpoint.empty())
+    std::cout << "Checkpoint: " << opts.checkpoint << " every "
+              << opts.checkpoint_every << " iterations\n";
+
+  if (opts.batch) {
+    route_batch(list_filename, opts);
+    return 0;
+  }
+
+  board_result_t board;
+  board.input = input_filename;
+  board.heatmap_filename = opts.heatmap_filename;
+  route_file(board, opts, init_start, std::cout);
 }
+#endif
 
 /* TODO (student): implement to_validate_format to convert Wire to
   validate_wire_t keypoint representation in order to run checker and
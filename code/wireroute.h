@@ -10,6 +10,8 @@
 #include <omp.h>
 #include <vector>
 
+#include "occgrid.h"
+
 #define MAX_PTS_PER_WIRE 5
 #define COST_REPORT_DEPTH 10
 
@@ -150,18 +152,20 @@ struct Wire {
 };
 
 
-// Definition of the wire checker
+// Definition of the wire checker, for either occupancy backend.
+// It only keeps references, so check before changing wires or occupancy.
+template <typename Grid>
 struct wr_checker {
-  std::vector<Wire> wires;
-  std::vector<std::vector<int>> occupancies;
+  const std::vector<Wire> &wires;
+  const Grid &occupancies;
   const int nwires;
   const int dim_x;
   const int dim_y;
-  wr_checker(std::vector<Wire> &wires,
-             std::vector<std::vector<int>> &occupancies)
+  wr_checker(const std::vector<Wire> &wires, const Grid &occupancies)
       : wires(wires), occupancies(occupancies), nwires(wires.size()),
-        dim_x(occupancies[0].size()), dim_y(occupancies.size()) {}
-  void validate() const;
+        dim_x(grid_dim_x(occupancies)), dim_y(grid_dim_y(occupancies)) {}
+  // returns the number of mismatches, quiet skips the report
+  int validate(bool quiet = false) const;
 };
 
 const char *get_option_string(const char *option_name,